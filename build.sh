@@ -11,37 +11,73 @@ if [ "$DEBUG" ]; then
 fi
 
 [ "$CC" ] || CC=gcc
-[ "$NAME" ] || NAME="nesEmu"
-CFLAGS="$CFLAGS -g -ISDL3-$SDL_VERSION/include/ -O2 -Wall -Wextra -Wpedantic -std=c99"
-LDFLAGS="$LDFLAGS -Wall -Wextra -Wpedantic"
+CFLAGS="$CFLAGS -g -O2 -Wall -Wextra -Wpedantic -std=c99 -pthread"
+LDFLAGS="$LDFLAGS -Wall -Wextra -Wpedantic -pthread"
+# DEFINES="-DBENCHMARK" prints the fps with the cap off, add -DPPU_DOT_RENDERER to draw every line a dot at a time for comparison
+# it also adds romPath --cpu-bench instructions to time just the cpu
+# DEFINES="-DJIT" builds the x86-64 recompiler, add -DJIT_VERIFY to check everything it runs against the interpreter
+# DEFINES="-DWIDE" builds the experimental x86-64 lockstep core and romPath --wide-bench lanes frames
 DEFINES="$DEFINES"
-# I'm probably not using rpath correctly lmao
-LIBS="-Wl,-rpath=./ -Wl,-rpath=build/ -L./build/ -lSDL3 "
+
+# HEADLESS=1 builds build/nesEmuHeadless, just the emulation with no SDL at all, it only runs with --headless
+# LIB=1 builds the same thing as build/libnesemu.so for other programs to use through src/nesemu.h
+if [ "$LIB" ]; then
+	HEADLESS=1
+	[ "$NAME" ] || NAME="libnesemu.so"
+	# only the nesemu functions get exported, and the per thread console pointers use the static tls block
+	# instead of going through __tls_get_addr on every access, there's only a few of them so it fits when the library gets dlopen()ed
+	CFLAGS="$CFLAGS -fPIC -fvisibility=hidden -ftls-model=initial-exec"
+	# and nothing gets printed, see romLog()
+	DEFINES="$DEFINES -DLIB"
+	LDFLAGS="$LDFLAGS -shared"
+fi
+
+if [ "$HEADLESS" ]; then
+	[ "$NAME" ] || NAME="nesEmuHeadless"
+	DEFINES="$DEFINES -DHEADLESS"
+	LIBS="-lm"
+else
+	[ "$NAME" ] || NAME="nesEmu"
+	CFLAGS="$CFLAGS -ISDL3-$SDL_VERSION/include/"
+	# I'm probably not using rpath correctly lmao
+	LIBS="-Wl,-rpath=./ -Wl,-rpath=build/ -L./build/ -lSDL3 "
+fi
 
 CFILES="$(find src/ -name "*.c")"
+if [ "$LIB" ]; then
+	CFILES="$(echo "$CFILES" | grep -v "src/main.c")"
+fi
 OBJS=""
 
-if ! [ -d "SDL3-$SDL_VERSION" ]; then
-	if ! [ -f "SDL3-$SDL_VERSION.tar.gz" ]; then
-		wget "https://github.com/libsdl-org/SDL/releases/download/release-$SDL_VERSION/SDL3-$SDL_VERSION.tar.gz"
+if ! [ "$HEADLESS" ]; then
+	if ! [ -d "SDL3-$SDL_VERSION" ]; then
+		if ! [ -f "SDL3-$SDL_VERSION.tar.gz" ]; then
+			wget "https://github.com/libsdl-org/SDL/releases/download/release-$SDL_VERSION/SDL3-$SDL_VERSION.tar.gz"
+		fi
+		tar -xavf SDL3-$SDL_VERSION.tar.gz
 	fi
-	tar -xavf SDL3-$SDL_VERSION.tar.gz
-fi
 
-if ! [ -f "SDL3-$SDL_VERSION/build/libSDL3.so.0" ]; then
-	ORIGIN_DIR="$(pwd)"
-	cd "$ORIGIN_DIR/SDL3-$SDL_VERSION"
-	cmake -S . -B build
-	cmake --build build -j "$(nproc)"
-	cd "$ORIGIN_DIR"
+	if ! [ -f "SDL3-$SDL_VERSION/build/libSDL3.so.0" ]; then
+		ORIGIN_DIR="$(pwd)"
+		cd "$ORIGIN_DIR/SDL3-$SDL_VERSION"
+		cmake -S . -B build
+		cmake --build build -j "$(nproc)"
+		cd "$ORIGIN_DIR"
+	fi
 fi
 
-rm -rf build/ obj/
+# the headless build leaves build/ alone so it can sit next to the normal one
+if [ "$HEADLESS" ]; then
+	rm -rf obj/
+	mkdir -p build/ obj/
+else
+	rm -rf build/ obj/
 
-mkdir build/ obj/
+	mkdir build/ obj/
 
-# idk why I specifically need this file instead of just libSDL2.so
-cp SDL3-$SDL_VERSION/build/libSDL3.so SDL3-$SDL_VERSION/build/libSDL3.so.0 build/
+	# idk why I specifically need this file instead of just libSDL2.so
+	cp SDL3-$SDL_VERSION/build/libSDL3.so SDL3-$SDL_VERSION/build/libSDL3.so.0 build/
+fi
 
 for f in $CFILES; do
 	OBJNAME="$(echo "$f" | sed -e "s/\.c/\.o/" -e "s/src/obj/")"
@@ -2,164 +2,125 @@
 
 #include "apu.h"
 
-#include "SDL3/SDL.h"
+#ifndef HEADLESS
+	#include "SDL3/SDL.h"
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdlib.h>
 
 #include "cpu.h"
 #include "ram.h"
 #include "rom.h"
 #include "ppu.h"
 #include "debug.h"
+#include "blip.h"
+
+#define CPU_FREQ 1789773
+// samples get made a video frame's worth of cpu cycles at a time
+#define AUDIO_FRAME_CYCLES 29781
+
+__thread apu_t* apu;
 
+// https://www.nesdev.org/wiki/APU_Mixer#Lookup_Table
+float pulseTable[31];
+float tndTable[203];
+
+#ifndef HEADLESS
 SDL_AudioStream* stream = NULL;
 
-#define CPU_FREQ 1789773
-#define SAMPLE_RATE 48000
 #define BUFFER_SIZE SAMPLE_RATE/20
 
-struct envStruct {
-	uint8_t constantVolFlag;
-	uint8_t volume;
-	uint8_t timer;
-	uint8_t decayCounter;
-	uint8_t startFlag;
-	uint8_t loop;
-};
-
-struct {
-	struct {
-		uint16_t timer;
-		int16_t timerPeriod;
-		int16_t targetPeriod;
-		uint8_t counter;
-		uint8_t loop;
-		uint8_t duty;
-		uint8_t dutyCycleProgress;
-		struct {
-			uint8_t enabled;
-			uint8_t shiftCount;
-			uint8_t timer;
-			uint8_t timerPeriod;
-			uint8_t negate;
-			uint8_t reloadFlag;
-		} sweep;
-		struct envStruct env;
-		uint8_t enabled;
-		uint8_t mute;
-	} pulse[2];
-	struct {
-		uint16_t lfsr;
-		uint16_t timer;
-		uint8_t timerPeriod;
-		uint8_t counter;
-		uint8_t mode;
-		struct envStruct env;
-		uint8_t enabled;
-	} noise;
-	struct {
-		uint16_t timer;
-		uint16_t timerPeriod;
-		uint8_t lengthCounter;
-		uint8_t linearCounter;
-		uint8_t progress;
-		uint8_t reloadFlag;
-		uint8_t reloadValue;
-		uint8_t controlFlag;
-		struct envStruct env;
-		uint8_t enabled;
-	} tri;
-	struct {
-		uint16_t sampleAddress;
-		uint16_t sampleLength;
-		uint16_t bytesRemaining;
-		uint16_t currentAddress;
-		uint8_t irqEnable;
-		uint8_t irqSignal;
-		uint8_t loopFlag;
-		uint16_t rate;
-		uint16_t timer;
-		uint8_t sampleBuffer;
-		uint8_t sampleBitsLeft;
-		uint8_t output;
-		uint8_t silence;
-	} dmc;
-	uint64_t frameCounter;
-	uint64_t cycles;
-	uint8_t mode;
-	uint8_t irqInhibit;
-	uint8_t irqSignal;
-} apu;
-
-uint32_t currentSample;
-float samples[BUFFER_SIZE];
-
-struct callbackPointers {
-	uint32_t* currentSample;
-	float* samples;
-};
+void audioRingPush(float sample) {
+	uint32_t write = SDL_GetAtomicInt(&apu->ring.writePos);
+	uint32_t read = SDL_GetAtomicInt(&apu->ring.readPos);
+	if(write - read >= AUDIO_RING_SIZE) {
+		SDL_AddAtomicInt(&apu->ring.overruns, 1);
+		return;
+	}
+	apu->ring.samples[write % AUDIO_RING_SIZE] = sample;
+	SDL_SetAtomicInt(&apu->ring.writePos, write + 1);
+}
 
 // https://github.com/libsdl-org/SDL/blob/main/examples/audio/02-simple-playback-callback/simple-playback-callback.c
+// userdata is the ring of the console being played, this runs on SDL's audio thread where apu doesn't point at anything
 void audioCallback(void* userdata, SDL_AudioStream* stream, int additionalAmount, int totalAmount) {
-	int samplesQueued = SDL_GetAudioStreamQueued(stream)/sizeof(float);
-	if(samplesQueued > BUFFER_SIZE) {
-		SDL_ClearAudioStream(stream); // this is to attempt to fix some audio stuttering, I think this fixed it but I'm not sure
-	}
-	//printf("%i\n", samplesQueued);
-	struct callbackPointers* p = (struct callbackPointers*)userdata;
+	audioRing_t* ring = userdata;
+	(void)totalAmount;
 	additionalAmount /= sizeof(float);
-	float lastSample = 0;
-	#define FALLBACK_BUFFER_SIZE 128
-	static float fallbackBuffer[FALLBACK_BUFFER_SIZE];
-	if(*p->currentSample > 0 && additionalAmount > 0) {
-		SDL_PutAudioStreamData(stream, p->samples, *p->currentSample * sizeof(float));
-		lastSample = samples[*p->currentSample - 1];
-		additionalAmount -= *p->currentSample;
-		if(additionalAmount > 0) {
-			//printf("out of queued samples! need %i more, using fallback buffer\n", additionalAmount);
-			for(uint32_t i = 0; i < FALLBACK_BUFFER_SIZE; ++i) {
-				fallbackBuffer[i] = lastSample;
-			}
-		}
-		*p->currentSample = 0;
-	}
+	#define CALLBACK_CHUNK_SIZE 256
+	float chunk[CALLBACK_CHUNK_SIZE];
 	while(additionalAmount > 0) {
-		SDL_PutAudioStreamData(stream, fallbackBuffer, FALLBACK_BUFFER_SIZE*sizeof(float));
-		additionalAmount -= FALLBACK_BUFFER_SIZE;
+		uint32_t read = SDL_GetAtomicInt(&ring->readPos);
+		uint32_t available = (uint32_t)SDL_GetAtomicInt(&ring->writePos) - read;
+		uint32_t count = additionalAmount < CALLBACK_CHUNK_SIZE ? additionalAmount : CALLBACK_CHUNK_SIZE;
+		uint32_t i = 0;
+		for(; i < count && i < available; ++i) {
+			chunk[i] = ring->samples[(read + i) % AUDIO_RING_SIZE];
+		}
+		SDL_SetAtomicInt(&ring->readPos, read + i);
+		if(i < count) {
+			SDL_AddAtomicInt(&ring->underruns, count - i);
+		}
+		for(; i < count; ++i) {
+			chunk[i] = (i == 0 ? ring->lastSample : chunk[i - 1]);
+		}
+		ring->lastSample = chunk[count - 1];
+		SDL_PutAudioStreamData(stream, chunk, count * sizeof(float));
+		additionalAmount -= count;
 	}
 }
 
 void initAPU(void) {
 	SDL_AudioSpec spec;
 
+	// without a device the samples just pile up in apu.samples like they do headless
 	if(SDL_Init(SDL_INIT_AUDIO) == 0) {
-		printf("could not initialize SDL's audio\n");
-		exit(1);
+		printf("could not initialize SDL's audio, running without sound\n");
+		return;
 	}
 
 	spec.channels = 1;
 	spec.format = SDL_AUDIO_F32;
 	spec.freq = SAMPLE_RATE;
 
-	static struct callbackPointers p = {
-		.currentSample = &currentSample,
-		.samples = samples
-	};
-
-	stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, audioCallback, &p);
+	stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, audioCallback, &apu->ring);
 	if(stream == NULL) {
-		printf("could not create audio stream\n");
-		exit(1);
+		printf("could not create audio stream, running without sound\n");
+		return;
 	}
-	memset(samples, 0, sizeof(samples));
-	SDL_PutAudioStreamData(stream, samples, sizeof(samples));
+	// start out with some silence queued so the emulation has time to get ahead
+	static float silence[BUFFER_SIZE];
+	SDL_PutAudioStreamData(stream, silence, sizeof(silence));
 	SDL_ResumeAudioStreamDevice(stream);
+	apu->playing = 1;
+}
 
-	apu.noise.lfsr = 1;
-	apu.irqSignal = 1;
-	apu.dmc.irqSignal = 1;
+void apuUninit(void) {
+	// waits for the callback to finish, after this nothing touches apu.ring from another thread
+	if(stream) {
+		SDL_DestroyAudioStream(stream);
+		stream = NULL;
+	}
+	apu->playing = 0;
+}
+#endif
+
+void apuInitTables(void) {
+	blipInitKernel();
+	for(uint8_t i = 1; i < 31; ++i) {
+		pulseTable[i] = 95.52f / (8128.0f / i + 100.0f);
+	}
+	for(uint8_t i = 1; i < 203; ++i) {
+		tndTable[i] = 163.67f / (24329.0f / i + 100.0f);
+	}
+}
+
+void apuInitState(void) {
+	blipInit(&apu->blip, CPU_FREQ, SAMPLE_RATE);
+	apu->noise.lfsr = 1;
+	apu->irqSignal = 1;
+	apu->dmc.irqSignal = 1;
 }
 
 // https://www.nesdev.org/wiki/APU_Pulse
@@ -170,15 +131,15 @@ uint8_t pulseDutyCycleLUT[] = {
 	0xFC,
 };
 uint8_t pulseGetSample(uint8_t index) {
-	if(apu.pulse[index].mute) { return 0; }
-	if(apu.pulse[index].counter != 0 && apu.pulse[index].timerPeriod > 8) {
+	if(apu->pulse[index].mute) { return 0; }
+	if(apu->pulse[index].counter != 0 && apu->pulse[index].timerPeriod > 8) {
 		uint8_t output;
-		if(apu.pulse[index].env.constantVolFlag) {
-			output = apu.pulse[index].env.volume;
+		if(apu->pulse[index].env.constantVolFlag) {
+			output = apu->pulse[index].env.volume;
 		} else {
-			output = apu.pulse[index].env.decayCounter;
+			output = apu->pulse[index].env.decayCounter;
 		}
-		if((pulseDutyCycleLUT[apu.pulse[index].duty] >> apu.pulse[index].dutyCycleProgress) & 1) {
+		if((pulseDutyCycleLUT[apu->pulse[index].duty] >> apu->pulse[index].dutyCycleProgress) & 1) {
 			output = 0;
 		}
 		return output;
@@ -191,14 +152,14 @@ uint16_t noiseTimerLUT[] = {
 	4/2, 8/2, 16/2, 32/2, 64/2, 96/2, 128/2, 160/2, 202/2, 254/2, 380/2, 508/2, 762/2, 1016/2, 2034/2, 4068/2
 };
 uint8_t noiseGetSample(void) {
-	if(apu.noise.counter > 0) {
+	if(apu->noise.counter > 0) {
 		uint8_t output;
-		if(apu.noise.env.constantVolFlag) {
-			output = apu.noise.env.volume;
+		if(apu->noise.env.constantVolFlag) {
+			output = apu->noise.env.volume;
 		} else {
-			output = apu.noise.env.decayCounter;
+			output = apu->noise.env.decayCounter;
 		}
-		if((apu.noise.lfsr & 1) == 0) {
+		if((apu->noise.lfsr & 1) == 0) {
 			output = 0;
 		}
 		return output;
@@ -213,55 +174,55 @@ uint8_t triLUT[] = {
 };
 
 uint8_t triGetSample(void) {
-	if(apu.tri.timerPeriod == 0) { return 0; }
-	return triLUT[apu.tri.progress];
+	if(apu->tri.timerPeriod == 0) { return 0; }
+	return triLUT[apu->tri.progress];
 }
 
 float dmcGetSample(void) {
-	return (apu.dmc.output/256.0) - 0.25f;
+	return (apu->dmc.output/256.0) - 0.25f;
 }
 
 void updateSweeps(void) {
 	for(uint8_t i = 0; i < 2; ++i) {
-		if(apu.pulse[i].sweep.timer == 0 && apu.pulse[i].sweep.enabled && apu.pulse[i].sweep.shiftCount > 0) {
-			if(!apu.pulse[i].mute) {
-				apu.pulse[i].timerPeriod = apu.pulse[i].targetPeriod;
+		if(apu->pulse[i].sweep.timer == 0 && apu->pulse[i].sweep.enabled && apu->pulse[i].sweep.shiftCount > 0) {
+			if(!apu->pulse[i].mute) {
+				apu->pulse[i].timerPeriod = apu->pulse[i].targetPeriod;
 			}
 		}
-		if(apu.pulse[i].sweep.timer == 0 || apu.pulse[i].sweep.reloadFlag) {
-			apu.pulse[i].sweep.timer = apu.pulse[i].sweep.timerPeriod;
-			apu.pulse[i].sweep.reloadFlag = 0;
+		if(apu->pulse[i].sweep.timer == 0 || apu->pulse[i].sweep.reloadFlag) {
+			apu->pulse[i].sweep.timer = apu->pulse[i].sweep.timerPeriod;
+			apu->pulse[i].sweep.reloadFlag = 0;
 		} else {
-			--apu.pulse[i].sweep.timer;
+			--apu->pulse[i].sweep.timer;
 		}
 	}
 }
 
 void updateLengthCounters(void) {
-	if(apu.pulse[0].enabled && !apu.pulse[0].loop && apu.pulse[0].counter != 0) {
-		--apu.pulse[0].counter;
+	if(apu->pulse[0].enabled && !apu->pulse[0].loop && apu->pulse[0].counter != 0) {
+		--apu->pulse[0].counter;
 	}
-	if(apu.pulse[1].enabled && !apu.pulse[1].loop && apu.pulse[1].counter != 0) {
-		--apu.pulse[1].counter;
+	if(apu->pulse[1].enabled && !apu->pulse[1].loop && apu->pulse[1].counter != 0) {
+		--apu->pulse[1].counter;
 	}
-	if(apu.noise.enabled && apu.noise.counter > 0 && !apu.noise.env.loop) {
-		--apu.noise.counter;
+	if(apu->noise.enabled && apu->noise.counter > 0 && !apu->noise.env.loop) {
+		--apu->noise.counter;
 	}
-	if(apu.tri.enabled && !apu.tri.controlFlag && apu.tri.lengthCounter > 0) {
-		--apu.tri.lengthCounter;
+	if(apu->tri.enabled && !apu->tri.controlFlag && apu->tri.lengthCounter > 0) {
+		--apu->tri.lengthCounter;
 	}
 }
 
 void updateLinearCounter(void) {
-	if(apu.tri.reloadFlag) {
-		apu.tri.linearCounter = apu.tri.reloadValue;
+	if(apu->tri.reloadFlag) {
+		apu->tri.linearCounter = apu->tri.reloadValue;
 	} else {
-		if(apu.tri.linearCounter > 0) {
-			--apu.tri.linearCounter;
+		if(apu->tri.linearCounter > 0) {
+			--apu->tri.linearCounter;
 		}
 	}
-	if(!apu.tri.controlFlag) {
-		apu.tri.reloadFlag = 0;
+	if(!apu->tri.controlFlag) {
+		apu->tri.reloadFlag = 0;
 	}
 }
 
@@ -287,123 +248,166 @@ void updateEnv(struct envStruct* env) {
 }
 
 void updateEnvelopes(void) {
-	updateEnv(&apu.pulse[0].env);
-	updateEnv(&apu.pulse[1].env);
-	updateEnv(&apu.noise.env);
+	updateEnv(&apu->pulse[0].env);
+	updateEnv(&apu->pulse[1].env);
+	updateEnv(&apu->noise.env);
 }
 
 void dmcDMA(void) {
-	apu.dmc.sampleBuffer = ramReadByte(apu.dmc.currentAddress);
-	++apu.dmc.currentAddress;
-	--apu.dmc.bytesRemaining;
-	apu.dmc.sampleBitsLeft = 8;
-	apu.dmc.silence = 0;
-	if(apu.dmc.bytesRemaining == 0) {
-		if(apu.dmc.loopFlag) {
-			apu.dmc.currentAddress = apu.dmc.sampleAddress;
-			apu.dmc.bytesRemaining = apu.dmc.sampleLength;
-		} else if(apu.dmc.irqEnable) {
-			apu.dmc.irqSignal = 0;
+	apu->dmc.sampleBuffer = ramReadByte(apu->dmc.currentAddress);
+	++apu->dmc.currentAddress;
+	--apu->dmc.bytesRemaining;
+	apu->dmc.sampleBitsLeft = 8;
+	apu->dmc.silence = 0;
+	if(apu->dmc.bytesRemaining == 0) {
+		if(apu->dmc.loopFlag) {
+			apu->dmc.currentAddress = apu->dmc.sampleAddress;
+			apu->dmc.bytesRemaining = apu->dmc.sampleLength;
+		} else if(apu->dmc.irqEnable) {
+			apu->dmc.irqSignal = 0;
 		}
 	}
 }
 
+// https://www.nesdev.org/wiki/APU_Mixer
+void apuMix(void) {
+	apu->outputChanged = 0;
+	uint8_t pulseLevel = pulseGetSample(0) + pulseGetSample(1);
+	uint8_t tndLevel = 3*triGetSample() + 2*noiseGetSample() + apu->dmc.output;
+	float output = pulseTable[pulseLevel] + tndTable[tndLevel] + rom->expandedAudioGetSample();
+	if(output != apu->output) {
+		blipAddDelta(&apu->blip, apu->cycles, output - apu->output);
+		apu->output = output;
+	}
+}
+
+void apuEndAudioFrame(void) {
+	#ifndef HEADLESS
+		if(apu->playing) {
+			float samples[BLIP_MAX_SAMPLES];
+			uint32_t count = blipEndFrame(&apu->blip, apu->cycles, samples);
+			for(uint32_t i = 0; i < count; ++i) {
+				audioRingPush(samples[i]);
+			}
+			apu->cycles = 0;
+			return;
+		}
+	#endif
+	// nothing's taken the samples in a while, start over instead of running off the end
+	if(apu->sampleCount > APU_SAMPLE_BUFFER - BLIP_MAX_SAMPLES) {
+		apu->sampleCount = 0;
+	}
+	apu->sampleCount += blipEndFrame(&apu->blip, apu->cycles, &apu->samples[apu->sampleCount]);
+	apu->cycles = 0;
+}
+
+void apuOutputChanged(void) {
+	apu->outputChanged = 1;
+}
+
 void apuStep(void) {
 	for(uint8_t i = 0; i < 2; ++i) {
-		int16_t change = apu.pulse[i].timerPeriod >> apu.pulse[i].sweep.shiftCount;
-		if(apu.pulse[i].sweep.negate) {
+		int16_t change = apu->pulse[i].timerPeriod >> apu->pulse[i].sweep.shiftCount;
+		if(apu->pulse[i].sweep.negate) {
 			change *= -1;
 			if(i == 0) {
 				--change;
 			}
 		}
-		apu.pulse[i].targetPeriod = apu.pulse[i].timerPeriod + change;
-		if(apu.pulse[i].targetPeriod < 0) {
-			apu.pulse[i].targetPeriod = 0;
+		apu->pulse[i].targetPeriod = apu->pulse[i].timerPeriod + change;
+		if(apu->pulse[i].targetPeriod < 0) {
+			apu->pulse[i].targetPeriod = 0;
 		}
-		if(apu.pulse[i].timerPeriod < 8 || apu.pulse[i].targetPeriod > 0x7FF) {
-			apu.pulse[i].mute = 1;
+		if(apu->pulse[i].timerPeriod < 8 || apu->pulse[i].targetPeriod > 0x7FF) {
+			apu->pulse[i].mute = 1;
 		} else {
-			apu.pulse[i].mute = 0;
+			apu->pulse[i].mute = 0;
 		}
 	}
-	if(apu.frameCounter%2 == 0) {
-		if(apu.pulse[0].timer > 0) {
-			--apu.pulse[0].timer;
+	if(apu->frameCounter%2 == 0) {
+		if(apu->pulse[0].timer > 0) {
+			--apu->pulse[0].timer;
 		} else {
-			--apu.pulse[0].dutyCycleProgress;
-			apu.pulse[0].dutyCycleProgress %= 8;
-			apu.pulse[0].timer = apu.pulse[0].timerPeriod;
+			--apu->pulse[0].dutyCycleProgress;
+			apu->pulse[0].dutyCycleProgress %= 8;
+			apu->pulse[0].timer = apu->pulse[0].timerPeriod;
+			apu->outputChanged |= apu->pulse[0].counter != 0;
 		}
-		if(apu.pulse[1].timer > 0) {
-			--apu.pulse[1].timer;
+		if(apu->pulse[1].timer > 0) {
+			--apu->pulse[1].timer;
 		} else {
-			--apu.pulse[1].dutyCycleProgress;
-			apu.pulse[1].dutyCycleProgress %= 8;
-			apu.pulse[1].timer = apu.pulse[1].timerPeriod;
+			--apu->pulse[1].dutyCycleProgress;
+			apu->pulse[1].dutyCycleProgress %= 8;
+			apu->pulse[1].timer = apu->pulse[1].timerPeriod;
+			apu->outputChanged |= apu->pulse[1].counter != 0;
 		}
-		if(apu.noise.timer > 0) {
-			--apu.noise.timer;
+		if(apu->noise.timer > 0) {
+			--apu->noise.timer;
 		} else {
-			uint8_t feedback = apu.noise.lfsr & 1;
-			if(apu.noise.mode == 0) {
-				feedback ^= (apu.noise.lfsr >> 1) & 1;
+			uint8_t feedback = apu->noise.lfsr & 1;
+			if(apu->noise.mode == 0) {
+				feedback ^= (apu->noise.lfsr >> 1) & 1;
 			} else {
-				feedback ^= (apu.noise.lfsr >> 6) & 1;
+				feedback ^= (apu->noise.lfsr >> 6) & 1;
 			}
-			apu.noise.lfsr >>= 1;
-			apu.noise.lfsr |= feedback << 14;
+			// the output only depends on bit 0
+			apu->outputChanged |= apu->noise.counter > 0 && ((apu->noise.lfsr ^ (apu->noise.lfsr >> 1)) & 1);
+			apu->noise.lfsr >>= 1;
+			apu->noise.lfsr |= feedback << 14;
 
-			apu.noise.timer = apu.noise.timerPeriod;
+			apu->noise.timer = apu->noise.timerPeriod;
 		}
-		if(apu.dmc.timer > 0) {
-			--apu.dmc.timer;
+		if(apu->dmc.timer > 0) {
+			--apu->dmc.timer;
 		} else {
 			// output unit
-			if(apu.dmc.sampleBitsLeft > 0 && !apu.dmc.silence) {
-				--apu.dmc.sampleBitsLeft;
-				uint8_t delta = apu.dmc.sampleBuffer & 1;
-				apu.dmc.sampleBuffer >>= 1;
+			if(apu->dmc.sampleBitsLeft > 0 && !apu->dmc.silence) {
+				--apu->dmc.sampleBitsLeft;
+				uint8_t delta = apu->dmc.sampleBuffer & 1;
+				apu->dmc.sampleBuffer >>= 1;
 				if(delta == 1) {
-					if(apu.dmc.output < 126) {
-						apu.dmc.output += 2;
+					if(apu->dmc.output < 126) {
+						apu->dmc.output += 2;
 					}
 				} else {
-					if(apu.dmc.output > 1) {
-						apu.dmc.output -= 2;
+					if(apu->dmc.output > 1) {
+						apu->dmc.output -= 2;
 					}
 				}
+				apu->outputChanged = 1;
 			}
 			// memory reader
-			if(apu.dmc.sampleBitsLeft == 0) {
-				if(apu.dmc.bytesRemaining > 0) {
+			if(apu->dmc.sampleBitsLeft == 0) {
+				if(apu->dmc.bytesRemaining > 0) {
 					dmcDMA();
 				} else {
-					apu.dmc.silence = 1;
+					apu->dmc.silence = 1;
 				}
 			}
 
-			apu.dmc.timer = apu.dmc.rate;
+			apu->dmc.timer = apu->dmc.rate;
 		}
 	}
-	cpu.irq &= apu.dmc.irqSignal;
+	cpu->irq &= apu->dmc.irqSignal;
 
-	if(apu.tri.linearCounter > 0 && apu.tri.lengthCounter > 0) {
-		if(apu.tri.timer > 0) {
-			--apu.tri.timer;
+	if(apu->tri.linearCounter > 0 && apu->tri.lengthCounter > 0) {
+		if(apu->tri.timer > 0) {
+			--apu->tri.timer;
 		} else {
-			apu.tri.timer = apu.tri.timerPeriod;
-			++apu.tri.progress;
-			apu.tri.progress %= 32;
+			apu->tri.timer = apu->tri.timerPeriod;
+			++apu->tri.progress;
+			apu->tri.progress %= 32;
+			apu->outputChanged |= apu->tri.timerPeriod != 0;
 		}
 	}
 
 
-	++apu.cycles;
-	++apu.frameCounter;
+	++apu->frameCounter;
 
-	if(apu.frameCounter % (3728*2) == 0) {
-		switch(apu.frameCounter / (3728*2)) {
+	if(apu->frameCounter % (3728*2) == 0) {
+		// envelopes and length counters
+		apu->outputChanged = 1;
+		switch(apu->frameCounter / (3728*2)) {
 			case 1:
 			case 3:
 				updateLinearCounter();
@@ -416,15 +420,15 @@ void apuStep(void) {
 				updateLengthCounters();
 				break;
 			case 4:
-				if(apu.mode == 0) {
+				if(apu->mode == 0) {
 					updateLinearCounter();
 					updateEnvelopes();
 					updateSweeps();
 					updateLengthCounters();
-					if(!apu.irqInhibit) {
-						apu.irqSignal = 0;
+					if(!apu->irqInhibit) {
+						apu->irqSignal = 0;
 					}
-					apu.frameCounter = 0;
+					apu->frameCounter = 0;
 				}
 				break;
 			case 5:
@@ -432,57 +436,19 @@ void apuStep(void) {
 				updateEnvelopes();
 				updateSweeps();
 				updateLengthCounters();
-				apu.frameCounter = 0;
+				apu->frameCounter = 0;
 				break;
 		}
 	}
-	cpu.irq &= apu.irqSignal;
+	cpu->irq &= apu->irqSignal;
 
 
-	// need to do actual resampling at some point instead of this lmao
-	if(apu.cycles % (CPU_FREQ/SAMPLE_RATE) == 0) {
-		if(currentSample < BUFFER_SIZE) {
-			// https://www.nesdev.org/wiki/APU_Mixer
-			float pulseOut = 0.0f;
-			uint8_t pulseSample = pulseGetSample(0) + pulseGetSample(1);
-			if(pulseSample != 0) {
-				pulseOut = 95.88f / ((8128.0f / pulseSample) + 100.0f);
-			}
-
-			// linear approximation
-			float triOut = 0.0f;
-			uint8_t triSample = triGetSample();
-			if(triSample != 0) {
-				triOut = triSample/8227.0f;
-			}
-
-			float noiseOut = 0.0f;
-			uint8_t noiseSample = noiseGetSample();
-			if(noiseSample != 0) {
-				noiseOut = noiseSample/12241.0f;
-			}
-
-			float dmcOut = 0.0f;
-			if(apu.dmc.output != 0) {
-				dmcOut = apu.dmc.output/22638.0f;
-			}
-
-			float triNoiseDMCOut = 159.79 / (1/(triOut+noiseOut+dmcOut) + 100.0f);
-			//float triNoiseDMCOut = 0.00851 * triGetSample() + 0.00494 * noiseGetSample() + 0.00335 * apu.dmc.output;
-			samples[currentSample] = 0.0f;
-			/*samples[currentSample] += pulseGetSample(0);
-			samples[currentSample] += pulseGetSample(1);*/
-			samples[currentSample] += pulseOut;
-			/*samples[currentSample] += noiseGetSample();
-			samples[currentSample] += triGetSample();
-			samples[currentSample] += dmcGetSample();*/
-			samples[currentSample] += triNoiseDMCOut;
-			samples[currentSample] += expandedAudioGetSample();
-			++currentSample;
-		} else {
-			SDL_FlushAudioStream(stream);
-		}
-		apu.cycles = 0;
+	if(apu->outputChanged) {
+		apuMix();
+	}
+	++apu->cycles;
+	if(apu->cycles == AUDIO_FRAME_CYCLES) {
+		apuEndAudioFrame();
 	}
 }
 
@@ -492,152 +458,152 @@ uint8_t lengthCounterLUT[] = {
 };
 
 void pulseSetVolume(uint8_t index, uint8_t volume) {
-	apu.pulse[index].env.volume = volume;
+	apu->pulse[index].env.volume = volume;
 }
 
 void pulseSetLoop(uint8_t index, uint8_t loop) {
-	apu.pulse[index].loop = loop;
+	apu->pulse[index].loop = loop;
 }
 
 
 void pulseSetTimerLow(uint8_t index, uint8_t timerLow) {
-	apu.pulse[index].timerPeriod &= 0xFF00;
-	apu.pulse[index].timerPeriod |= timerLow;
+	apu->pulse[index].timerPeriod &= 0xFF00;
+	apu->pulse[index].timerPeriod |= timerLow;
 }
 
 void pulseSetTimerHigh(uint8_t index, uint8_t timerHigh) {
-	apu.pulse[index].timerPeriod &= 0x00FF;
-	apu.pulse[index].timerPeriod |= timerHigh << 8;
-	apu.pulse[index].dutyCycleProgress = 0;
+	apu->pulse[index].timerPeriod &= 0x00FF;
+	apu->pulse[index].timerPeriod |= timerHigh << 8;
+	apu->pulse[index].dutyCycleProgress = 0;
 }
 
 void pulseSetLengthCounter(uint8_t index, uint8_t counter) {
-	if(apu.pulse[index].enabled) {
-		apu.pulse[index].counter = lengthCounterLUT[counter];
+	if(apu->pulse[index].enabled) {
+		apu->pulse[index].counter = lengthCounterLUT[counter];
 	}
-	apu.pulse[index].env.startFlag = 1;
+	apu->pulse[index].env.startFlag = 1;
 }
 
 void pulseSetDutyCycle(uint8_t index, uint8_t duty) {
-	apu.pulse[index].duty = duty;
+	apu->pulse[index].duty = duty;
 }
 
 void pulseSetEnableFlag(uint8_t index, uint8_t flag) {
 	if(flag) {
-		apu.pulse[index].enabled = 1;
+		apu->pulse[index].enabled = 1;
 	} else {
-		apu.pulse[index].enabled = 0;
-		apu.pulse[index].counter = 0;
+		apu->pulse[index].enabled = 0;
+		apu->pulse[index].counter = 0;
 	}
 }
 
 void pulseSetSweepEnable(uint8_t index, uint8_t flag) {
-	apu.pulse[index].sweep.enabled = flag;
-	apu.pulse[index].sweep.reloadFlag = 1;
+	apu->pulse[index].sweep.enabled = flag;
+	apu->pulse[index].sweep.reloadFlag = 1;
 }
 
 void pulseSetSweepTimer(uint8_t index, uint8_t timer) {
-	apu.pulse[index].sweep.timerPeriod = timer;
+	apu->pulse[index].sweep.timerPeriod = timer;
 }
 
 void pulseSetSweepNegate(uint8_t index, uint8_t flag) {
-	apu.pulse[index].sweep.negate = flag;
+	apu->pulse[index].sweep.negate = flag;
 }
 
 void pulseSetSweepShift(uint8_t index, uint8_t shift) {
-	apu.pulse[index].sweep.shiftCount = shift;
+	apu->pulse[index].sweep.shiftCount = shift;
 }
 
 void pulseSetConstVolFlag(uint8_t index, uint8_t flag) {
-	apu.pulse[index].env.constantVolFlag = flag;
+	apu->pulse[index].env.constantVolFlag = flag;
 }
 
 void noiseSetTimer(uint8_t timer) {
 	timer &= 0x0F;
-	apu.noise.timerPeriod = noiseTimerLUT[timer];
+	apu->noise.timerPeriod = noiseTimerLUT[timer];
 }
 
 void noiseSetLengthcounter(uint8_t counter) {
-	apu.noise.counter = lengthCounterLUT[counter];
-	apu.noise.env.startFlag = 1;
+	apu->noise.counter = lengthCounterLUT[counter];
+	apu->noise.env.startFlag = 1;
 }
 
 void noiseSetEnableFlag(uint8_t flag) {
 	if(flag) {
-		apu.noise.enabled = 1;
+		apu->noise.enabled = 1;
 	} else {
-		apu.noise.enabled = 0;
-		apu.noise.counter = 0;
+		apu->noise.enabled = 0;
+		apu->noise.counter = 0;
 	}
 }
 
 void noiseSetVolume(uint8_t volume) {
-	apu.noise.env.volume = volume;
+	apu->noise.env.volume = volume;
 }
 
 void noiseSetConstVolFlag(uint8_t flag) {
-	apu.noise.env.constantVolFlag = flag;
+	apu->noise.env.constantVolFlag = flag;
 }
 
 void noiseSetLoop(uint8_t flag) {
-	apu.noise.env.loop = flag;
+	apu->noise.env.loop = flag;
 }
 
 void noiseSetMode(uint8_t mode) {
-	apu.noise.mode = mode;
+	apu->noise.mode = mode;
 }
 
 void triSetTimerLow(uint8_t timerLow) {
-	apu.tri.timerPeriod &= 0xFF00;
-	apu.tri.timerPeriod |= timerLow;
+	apu->tri.timerPeriod &= 0xFF00;
+	apu->tri.timerPeriod |= timerLow;
 }
 
 void triSetTimerHigh(uint8_t timerHigh) {
-	apu.tri.timerPeriod &= 0x00FF;
-	apu.tri.timerPeriod |= timerHigh << 8;
+	apu->tri.timerPeriod &= 0x00FF;
+	apu->tri.timerPeriod |= timerHigh << 8;
 }
 
 void triSetLengthCounter(uint8_t counter) {
-	apu.tri.lengthCounter = lengthCounterLUT[counter];
+	apu->tri.lengthCounter = lengthCounterLUT[counter];
 }
 
 void triSetCounterReload(uint8_t reload) {
-	apu.tri.reloadValue = reload;
+	apu->tri.reloadValue = reload;
 }
 
 void triSetEnableFlag(uint8_t flag) {
 	if(flag) {
-		apu.tri.enabled = 1;
+		apu->tri.enabled = 1;
 	} else {
-		apu.tri.enabled = 0;
-		apu.tri.lengthCounter = 0;
+		apu->tri.enabled = 0;
+		apu->tri.lengthCounter = 0;
 	}
 }
 
 void triSetReloadFlag(uint8_t flag) {
 	if(flag) {
-		apu.tri.reloadFlag = 1;
+		apu->tri.reloadFlag = 1;
 	} else {
-		apu.tri.reloadFlag = 0;
+		apu->tri.reloadFlag = 0;
 	}
 }
 
 void triSetControlFlag(uint8_t flag) {
 	if(flag) {
-		apu.tri.controlFlag = 1;
+		apu->tri.controlFlag = 1;
 	} else {
-		apu.tri.controlFlag = 0;
+		apu->tri.controlFlag = 0;
 	}
 }
 
 void apuSetFrameCounterMode(uint8_t byte) {
-	apu.frameCounter = 0;
-	apu.mode = byte >> 7;
-	apu.irqInhibit = (byte >> 6) & 1;
+	apu->frameCounter = 0;
+	apu->mode = byte >> 7;
+	apu->irqInhibit = (byte >> 6) & 1;
 	if(byte & 0x40) {
-		apu.irqSignal = 1;
+		apu->irqSignal = 1;
 	}
-	if(apu.mode == 1) {
+	if(apu->mode == 1) {
 		updateLinearCounter();
 		updateEnvelopes();
 		updateSweeps();
@@ -645,75 +611,107 @@ void apuSetFrameCounterMode(uint8_t byte) {
 	}
 }
 
+// the dmc reads its samples through the cpu's bus, which changes the open bus value
+uint8_t apuDMCActive(void) {
+	return apu->dmc.bytesRemaining > 0;
+}
+
+// how many cycles from now the frame counter raises its irq, UINT32_MAX if it won't
+uint32_t apuCyclesUntilFrameIRQ(void) {
+	if(apu->mode != 0 || apu->irqInhibit || !apu->irqSignal) {
+		return UINT32_MAX;
+	}
+	// set on the step that takes frameCounter to the 4th quarter frame
+	return 4*3728*2 - 1 - apu->frameCounter;
+}
+
+// how many cycles from now the dmc's timer next runs out, which is when it could fetch the last byte and raise its irq
+// UINT32_MAX if there's no irq that could happen
+uint32_t apuCyclesUntilDMCFetch(void) {
+	if(apu->dmc.bytesRemaining == 0 || !apu->dmc.irqEnable || apu->dmc.loopFlag || !apu->dmc.irqSignal) {
+		return UINT32_MAX;
+	}
+	// the timer only gets clocked when frameCounter is even
+	return (apu->frameCounter & 1) + apu->dmc.timer*2;
+}
+
+uint8_t apuIRQAsserted(void) {
+	return !apu->irqSignal || !apu->dmc.irqSignal;
+}
+
 uint8_t apuGetStatus(void) {
 	uint8_t status = 0;
-	status |= (apu.pulse[0].counter > 0) << 0;
-	status |= (apu.pulse[1].counter > 0) << 1;
-	status |= (apu.tri.lengthCounter > 0) << 2;
-	status |= (apu.noise.counter > 0) << 3;
-	status |= (apu.dmc.bytesRemaining > 0) << 4;
+	status |= (apu->pulse[0].counter > 0) << 0;
+	status |= (apu->pulse[1].counter > 0) << 1;
+	status |= (apu->tri.lengthCounter > 0) << 2;
+	status |= (apu->noise.counter > 0) << 3;
+	status |= (apu->dmc.bytesRemaining > 0) << 4;
 
-	status |= (apu.irqSignal == 0) << 6;
-	status |= (apu.dmc.irqSignal == 0) << 7;
+	status |= (apu->irqSignal == 0) << 6;
+	status |= (apu->dmc.irqSignal == 0) << 7;
 
-	apu.irqSignal = 1;
+	apu->irqSignal = 1;
 	return status;
 }
 
 
+#ifndef HEADLESS
 void apuPrintDebug(void) {
 	drawDebugText(0, 0, "\
 %i\n\
 P1: %i %i %i\n\
 P2: %i %i %i\n\
 N: %i %i %i\n\
-T: %i %i %i", 
-		apu.cycles,
-		apu.pulse[0].env.volume, apu.pulse[0].env.decayCounter, apu.pulse[0].timerPeriod,
-		apu.pulse[1].env.volume, apu.pulse[1].env.decayCounter, apu.pulse[1].timerPeriod,
-		apu.noise.counter, apu.noise.timerPeriod, apu.noise.env.decayCounter,
-		apu.tri.linearCounter, apu.tri.lengthCounter, apu.tri.timerPeriod);
+T: %i %i %i\n\
+audio underruns: %i overruns: %i", 
+		apu->cycles,
+		apu->pulse[0].env.volume, apu->pulse[0].env.decayCounter, apu->pulse[0].timerPeriod,
+		apu->pulse[1].env.volume, apu->pulse[1].env.decayCounter, apu->pulse[1].timerPeriod,
+		apu->noise.counter, apu->noise.timerPeriod, apu->noise.env.decayCounter,
+		apu->tri.linearCounter, apu->tri.lengthCounter, apu->tri.timerPeriod,
+		SDL_GetAtomicInt(&apu->ring.underruns), SDL_GetAtomicInt(&apu->ring.overruns));
 }
+#endif
 
 
 void dmcSetIrqEnable(uint8_t flag) {
-	apu.dmc.irqEnable = flag;
+	apu->dmc.irqEnable = flag;
 	if(flag == 0) {
-		apu.dmc.irqSignal = 1;
+		apu->dmc.irqSignal = 1;
 	}
 }
 
 void dmcSetLoop(uint8_t loop) {
-	apu.dmc.loopFlag = loop;
+	apu->dmc.loopFlag = loop;
 }
 
 // https://www.nesdev.org/wiki/APU_DMC
 uint16_t ratesTable[] = {428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106,  84,  72,  54};
 void dmcSetRate(uint8_t rate) {
-	apu.dmc.rate = ratesTable[rate]/2;
+	apu->dmc.rate = ratesTable[rate]/2;
 }
 
 void dmcDirectLoad(uint8_t value) {
-	apu.dmc.output = value;
+	apu->dmc.output = value;
 }
 
 void dmcSetSampleAddress(uint8_t address) {
-	apu.dmc.sampleAddress = 0xC000 + address*64;
-	apu.dmc.currentAddress = apu.dmc.sampleAddress;
+	apu->dmc.sampleAddress = 0xC000 + address*64;
+	apu->dmc.currentAddress = apu->dmc.sampleAddress;
 }
 
 void dmcSetSampleLength(uint8_t length) {
-	apu.dmc.sampleLength = length*16 + 1;
+	apu->dmc.sampleLength = length*16 + 1;
 	//apu.dmc.bytesRemaining = apu.dmc.sampleLength;
 }
 
 void dmcSetEnableFlag(uint8_t flag) {
-	apu.dmc.irqSignal = 1;
+	apu->dmc.irqSignal = 1;
 	if(!flag) {
-		apu.dmc.bytesRemaining = 0;
-	} else if(apu.dmc.bytesRemaining == 0){
-		apu.dmc.bytesRemaining = apu.dmc.sampleLength;
-		apu.dmc.currentAddress = apu.dmc.sampleAddress;
+		apu->dmc.bytesRemaining = 0;
+	} else if(apu->dmc.bytesRemaining == 0){
+		apu->dmc.bytesRemaining = apu->dmc.sampleLength;
+		apu->dmc.currentAddress = apu->dmc.sampleAddress;
 		dmcDMA();
 	}
 }
@@ -3,8 +3,138 @@
 
 #include <stdint.h>
 
-void initAPU(void);
+#ifndef HEADLESS
+	#include "SDL3/SDL.h"
+#endif
+
+#include "blip.h"
+
+#define SAMPLE_RATE 48000
+// a couple audio frames' worth, whatever's running the console takes them about once a frame
+#define APU_SAMPLE_BUFFER (BLIP_MAX_SAMPLES*2)
+
+// nes_t gets allocated on one of these so anything in it aligned to a cache line really is
+#define CACHE_LINE 64
+
+#ifndef HEADLESS
+// https://en.wikipedia.org/wiki/Circular_buffer
+// samples go from the emulation thread to SDL's audio thread through a single producer single consumer ring
+// each side only ever writes its own position, and they're kept on separate cache lines so the two threads don't fight over one
+// positions only ever go up and wrap around as unsigned ints, the ring size has to be a power of 2 for that to work
+#define AUDIO_RING_SIZE 4096
+typedef struct {
+	SDL_AtomicInt writePos;
+	SDL_AtomicInt readPos __attribute__((aligned(CACHE_LINE)));
+	// an empty ring keeps repeating the last sample so running out doesn't click
+	float lastSample;
+	uint8_t readPad[CACHE_LINE - sizeof(SDL_AtomicInt) - sizeof(float)];
+	// samples thrown out because the ring was full, counted by the emulation
+	SDL_AtomicInt overruns;
+	// samples the callback had to make up because the ring was empty
+	SDL_AtomicInt underruns;
+	float samples[AUDIO_RING_SIZE];
+} __attribute__((aligned(CACHE_LINE))) audioRing_t;
+#endif
 
+struct envStruct {
+	uint8_t constantVolFlag;
+	uint8_t volume;
+	uint8_t timer;
+	uint8_t decayCounter;
+	uint8_t startFlag;
+	uint8_t loop;
+};
+
+typedef struct {
+	struct {
+		uint16_t timer;
+		int16_t timerPeriod;
+		int16_t targetPeriod;
+		uint8_t counter;
+		uint8_t loop;
+		uint8_t duty;
+		uint8_t dutyCycleProgress;
+		struct {
+			uint8_t enabled;
+			uint8_t shiftCount;
+			uint8_t timer;
+			uint8_t timerPeriod;
+			uint8_t negate;
+			uint8_t reloadFlag;
+		} sweep;
+		struct envStruct env;
+		uint8_t enabled;
+		uint8_t mute;
+	} pulse[2];
+	struct {
+		uint16_t lfsr;
+		uint16_t timer;
+		uint8_t timerPeriod;
+		uint8_t counter;
+		uint8_t mode;
+		struct envStruct env;
+		uint8_t enabled;
+	} noise;
+	struct {
+		uint16_t timer;
+		uint16_t timerPeriod;
+		uint8_t lengthCounter;
+		uint8_t linearCounter;
+		uint8_t progress;
+		uint8_t reloadFlag;
+		uint8_t reloadValue;
+		uint8_t controlFlag;
+		struct envStruct env;
+		uint8_t enabled;
+	} tri;
+	struct {
+		uint16_t sampleAddress;
+		uint16_t sampleLength;
+		uint16_t bytesRemaining;
+		uint16_t currentAddress;
+		uint8_t irqEnable;
+		uint8_t irqSignal;
+		uint8_t loopFlag;
+		uint16_t rate;
+		uint16_t timer;
+		uint8_t sampleBuffer;
+		uint8_t sampleBitsLeft;
+		uint8_t output;
+		uint8_t silence;
+	} dmc;
+	uint64_t frameCounter;
+	// cycles into the current audio frame
+	uint64_t cycles;
+	uint8_t mode;
+	uint8_t irqInhibit;
+	uint8_t irqSignal;
+	// set whenever something happens that could change what comes out, the channels only get mixed again when it is
+	uint8_t outputChanged;
+	// the mixed output as of the last time it changed
+	float output;
+	blip_t blip;
+	// mono samples at SAMPLE_RATE made since whatever's running the console last took them and set sampleCount back to 0
+	// only used when there isn't an audio device playing them
+	float samples[APU_SAMPLE_BUFFER];
+	uint32_t sampleCount;
+	#ifndef HEADLESS
+		// set by initAPU() once the device is open, the samples go through ring instead
+		uint8_t playing;
+		audioRing_t ring;
+	#endif
+} apu_t;
+
+extern __thread apu_t* apu;
+
+#ifndef HEADLESS
+// opens the audio device for the console the current thread is running
+void initAPU(void);
+// closes the audio device, has to happen before the console it's playing gets destroyed
+void apuUninit(void);
+#endif
+// the mixer and blip tables every console shares, filled in once by nesCreate()
+void apuInitTables(void);
+void apuInitState(void);
 
 void apuStep(void);
 // needs a better name
@@ -12,7 +142,15 @@ void apuFrameCheck(uint8_t cycles);
 
 void apuSetFrameCounterMode(uint8_t byte);
 
+// the channels only get mixed again when something says the output might have changed,
+// register writes and expansion audio have to call this whenever they could change what comes out
+void apuOutputChanged(void);
+
 uint8_t apuGetStatus(void);
+uint8_t apuDMCActive(void);
+uint32_t apuCyclesUntilFrameIRQ(void);
+uint32_t apuCyclesUntilDMCFetch(void);
+uint8_t apuIRQAsserted(void);
 
 void pulseSetVolume(uint8_t index, uint8_t volume);
 void pulseSetTimerLow(uint8_t index, uint8_t timerLow);
@@ -45,7 +183,9 @@ void triSetCounterReload(uint8_t reload);
 void triSetReloadFlag(uint8_t flag);
 void triSetControlFlag(uint8_t flag);
 
+#ifndef HEADLESS
 void apuPrintDebug(void);
+#endif
 
 void dmcSetEnableFlag(uint8_t flag);
 void dmcSetIrqEnable(uint8_t flag);
@@ -0,0 +1,78 @@
+// for clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+#include "bench.h"
+
+#ifdef BENCHMARK
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nes.h"
+#include "files.h"
+#include "headless.h"
+
+// cpu time used by this process, so other things running don't count against it
+double benchCPUSeconds(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+uint8_t cpuBenchmark(const char* path, uint64_t instructions) {
+	long size;
+	uint8_t* data = headlessReadFile(path, &size);
+	if(data == NULL) {
+		return 1;
+	}
+	nes_t* nes = nesCreate();
+	if(nes == NULL) {
+		printf("could not allocate the console\n");
+		free(data);
+		return 1;
+	}
+	// the top half is twice as big as it needs to be so writes to the prg have somewhere to go that isn't the prg
+	uint8_t* bus = calloc(0x18000, 1);
+	if(bus == NULL || loadROMFromMemory(data, size) != 0 || rom->isNSF) {
+		printf("could not load %s\n", path);
+		nesDestroy(nes);
+		free(bus);
+		free(data);
+		return 1;
+	}
+
+	// the prg banks the mapper starts with, everything below them starts out as zeroed ram
+	// there's no mapper for writes up there to go to, they get thrown away instead of changing the code
+	for(uint32_t page = 0x80; page < 0x100; ++page) {
+		if(ram->readPages[page]) {
+			memcpy(bus + (page << 8), ram->readPages[page], 0x100);
+		}
+	}
+	ramAddCodeRegion(bus, 0x10000);
+	ramMapReadPages(0, 0x10000, bus);
+	ramMapWritePages(0, 0x8000, bus);
+	ramMapWritePages(0x8000, 0x8000, bus + 0x10000);
+	cpuInit();
+
+	uint64_t nextNMI = BENCH_NMI_CYCLES;
+	double start = benchCPUSeconds();
+	for(uint64_t i = 0; i < instructions; ++i) {
+		cpuStep();
+		if(cpu->cycles >= nextNMI) {
+			cpu->nmi = 0;
+			nextNMI += BENCH_NMI_CYCLES;
+		}
+	}
+	double seconds = benchCPUSeconds() - start;
+
+	printf("%lu instructions in %.3f seconds, %.1f million a second\n", (unsigned long)instructions, seconds, instructions / seconds / 1e6);
+	printf("ended at pc %04X after %lu cycles\n", cpu->pc, (unsigned long)cpu->cycles);
+
+	nesDestroy(nes);
+	free(bus);
+	free(data);
+	return 0;
+}
+
+#endif
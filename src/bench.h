@@ -0,0 +1,21 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// cpu only benchmark, built with -DBENCHMARK, for timing changes to cpuStep() against an older build of it
+// the rom's starting prg goes on a flat 64k bus of plain memory so there's no ppu, apu or mapper to catch up,
+// and the nmi comes every frame's worth of cycles like it would on a real console so the game's handler still runs
+
+#ifdef BENCHMARK
+
+// how many cpu cycles there are between nmis
+#define BENCH_NMI_CYCLES 29780
+
+// runs instructions instructions of the rom through cpuStep() and prints how many a second it did
+// also prints where the cpu ended up, builds running the same instructions have to agree on that
+uint8_t cpuBenchmark(const char* path, uint64_t instructions);
+
+#endif
+
+#endif // BENCH_H
@@ -0,0 +1,100 @@
+#include "blip.h"
+
+#include <string.h>
+
+// SDL has its own math functions so the normal build doesn't need libm, the headless one only has libm
+#ifdef HEADLESS
+	#include <math.h>
+	#define BLIP_SIN sin
+	#define BLIP_COS cos
+	#define BLIP_EXP exp
+	#define BLIP_PI 3.141592653589793238462643383279502884
+#else
+	#include "SDL3/SDL.h"
+	#define BLIP_SIN SDL_sin
+	#define BLIP_COS SDL_cos
+	#define BLIP_EXP SDL_exp
+	#define BLIP_PI SDL_PI_D
+#endif
+
+// how many sub-sample positions a change can land at
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+// positions in the buffer are 32.32 fixed point samples
+#define BLIP_FRAC_BITS 32
+// cutoff as a fraction of the sample rate, a bit under nyquist to leave room for the window's rolloff
+#define BLIP_CUTOFF 0.45
+// https://www.nesdev.org/wiki/APU_Mixer#Emulation
+// the nes has a 90hz highpass on its output, it also keeps float error in the running sum from drifting off
+#define BLIP_HIGHPASS_HZ 90.0
+
+// a lowpassed impulse at each phase, it's the difference of a band-limited step since the buffer holds differences
+// it's the same for every buffer
+float blipKernel[BLIP_PHASES][BLIP_WIDTH];
+
+// https://en.wikipedia.org/wiki/Sinc_filter
+// https://en.wikipedia.org/wiki/Window_function#Blackman_window
+void blipInitKernel(void) {
+	for(uint32_t phase = 0; phase < BLIP_PHASES; ++phase) {
+		double center = BLIP_WIDTH/2 - 1 + (double)phase / BLIP_PHASES;
+		double total = 0.0;
+		double taps[BLIP_WIDTH];
+		for(uint32_t i = 0; i < BLIP_WIDTH; ++i) {
+			double x = i - center;
+			double window = 0.42 + 0.5*BLIP_COS(2.0*BLIP_PI * x / BLIP_WIDTH) + 0.08*BLIP_COS(4.0*BLIP_PI * x / BLIP_WIDTH);
+			double sinc = (x == 0.0 ? 1.0 : BLIP_SIN(2.0*BLIP_PI * BLIP_CUTOFF * x) / (2.0*BLIP_PI * BLIP_CUTOFF * x));
+			taps[i] = sinc * window;
+			total += taps[i];
+		}
+		// every phase has to add up to exactly the delta or the output would drift a little with every change
+		for(uint32_t i = 0; i < BLIP_WIDTH; ++i) {
+			blipKernel[phase][i] = taps[i] / total;
+		}
+	}
+}
+
+void blipInit(blip_t* blip, uint32_t clockRate, uint32_t sampleRate) {
+	blip->factor = ((uint64_t)sampleRate << BLIP_FRAC_BITS) / clockRate;
+	blip->highpass = BLIP_EXP(-2.0 * BLIP_PI * BLIP_HIGHPASS_HZ / sampleRate);
+	blipClear(blip);
+}
+
+void blipClear(blip_t* blip) {
+	blip->offset = 0;
+	blip->sum = 0.0f;
+	blip->lastIn = 0.0f;
+	blip->lastOut = 0.0f;
+	memset(blip->buffer, 0, sizeof(blip->buffer));
+}
+
+void blipAddDelta(blip_t* blip, uint32_t time, float delta) {
+	uint64_t pos = blip->offset + time * blip->factor;
+	uint32_t sample = pos >> BLIP_FRAC_BITS;
+	if(sample >= BLIP_MAX_SAMPLES) { return; }
+	float* kernel = blipKernel[(pos >> (BLIP_FRAC_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+	float* out = &blip->buffer[sample];
+	for(uint32_t i = 0; i < BLIP_WIDTH; ++i) {
+		out[i] += kernel[i] * delta;
+	}
+}
+
+uint32_t blipEndFrame(blip_t* blip, uint32_t length, float* out) {
+	uint64_t end = blip->offset + length * blip->factor;
+	uint32_t count = end >> BLIP_FRAC_BITS;
+	if(count > BLIP_MAX_SAMPLES) { count = BLIP_MAX_SAMPLES; }
+	blip->offset = end & (((uint64_t)1 << BLIP_FRAC_BITS) - 1);
+
+	// https://en.wikipedia.org/wiki/High-pass_filter#Algorithmic_implementation
+	for(uint32_t i = 0; i < count; ++i) {
+		blip->sum += blip->buffer[i];
+		blip->lastOut = blip->sum - blip->lastIn + blip->highpass * blip->lastOut;
+		blip->lastIn = blip->sum;
+		out[i] = blip->lastOut;
+	}
+
+	// the last change can reach BLIP_WIDTH samples past the end of the frame
+	memmove(blip->buffer, &blip->buffer[count], BLIP_WIDTH * sizeof(float));
+	memset(&blip->buffer[BLIP_WIDTH], 0, count * sizeof(float));
+
+	return count;
+}
@@ -0,0 +1,40 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <stdint.h>
+
+// https://slack.net/~ant/bl-synth/
+// band-limited synthesis, the apu only says when and by how much its output changes instead of getting point sampled every cycle
+// every change gets spread over a few output samples with a windowed sinc, so square waves don't alias into a mess
+// the buffer holds the differences between samples, they get added back up when a frame's worth gets read out
+
+// the most samples a frame can make, frames have to be shorter than this
+#define BLIP_MAX_SAMPLES 2048
+// how many output samples each change gets spread over
+#define BLIP_WIDTH 16
+
+typedef struct {
+	// clocks to samples, as 32.32 fixed point
+	uint64_t factor;
+	// where the current frame starts, always less than a sample in
+	uint64_t offset;
+	float sum;
+	float highpass;
+	float lastIn;
+	float lastOut;
+	float buffer[BLIP_MAX_SAMPLES + BLIP_WIDTH];
+} blip_t;
+
+// fills in the filter kernel every buffer shares, has to be called before anything gets added to one
+void blipInitKernel(void);
+void blipInit(blip_t* blip, uint32_t clockRate, uint32_t sampleRate);
+void blipClear(blip_t* blip);
+
+// time is in clocks since the start of the frame
+void blipAddDelta(blip_t* blip, uint32_t time, float delta);
+
+// ends the frame length clocks in, writes every sample that's done into out and returns how many there were
+// anything from the end of the frame that can still change carries over into the next one
+uint32_t blipEndFrame(blip_t* blip, uint32_t length, float* out);
+
+#endif // BLIP_H
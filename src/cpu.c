@@ -5,907 +5,635 @@
 
 #include "ram.h"
 #include "apu.h"
+#include "opcodes.h"
 
-cpu_t cpu;
-
-#define ARG8 ramReadByte(cpu.pc)
-#define ARG16 ADDR16(cpu.pc)
-#define IMM ARG8
-#define ZP ramReadByte(ARG8)
-#define ABS ramReadByte(ARG16)
-#define ZP_INDEX(v) ramReadByte((ARG8 + v) & 0xFF)
-#define ABS_INDEX(v) ramReadByte(ARG16 + v)
-#define INDIR_INDEX_Y ramReadByte(ADDR16(ARG8)+cpu.y)
-#define INDEX_INDIR_X ramReadByte(ADDR16(ARG8+cpu.x))
-
-#define ZP_ADDR ARG8
-#define ABS_ADDR ARG16
-#define ZP_INDEX_ADDR(v) ((ARG8 + v) & 0xFF)
-#define ABS_INDEX_ADDR(v) (ARG16 + v)
-#define INDIR_INDEX_Y_ADDR (ADDR16(ARG8)+cpu.y)
-#define INDEX_INDIR_X_ADDR (ADDR16(ARG8+cpu.x))
+__thread cpu_t* cpu;
 
 void cpuDumpState(void) {
-	printf("pc: %04X\n", cpu.pc);
-	printf("opcode: %02X\n", ramReadByte(cpu.pc));
-	printf("cycles: %u\n", cpu.cycles);
-	printf("a: %02X, x: %02X, y: %02X\n", cpu.a, cpu.x, cpu.y);
-	printf("p: %02X\n", cpu.p);
-	printf("s: %02X\n", cpu.s);
+	printf("pc: %04X\n", cpu->pc);
+	printf("opcode: %02X\n", ramReadByte(cpu->pc));
+	printf("cycles: %u\n", cpu->cycles);
+	printf("a: %02X, x: %02X, y: %02X\n", cpu->a, cpu->x, cpu->y);
+	printf("p: %02X\n", cpuGetP());
+	printf("s: %02X\n", cpu->s);
 	printf("\n");
 }
 
-void setFlag(uint8_t flag, uint8_t value) {
-	if(value) {
-		cpu.p |= flag;
-	} else {
-		cpu.p &= ~(flag);
-	}
+// https://www.nesdev.org/wiki/Status_flags
+// N, Z, C and V aren't kept in cpu.p, only the values they come from are stored
+// and the status byte gets built when something actually needs all of it
+uint8_t cpuGetP(void) {
+	uint8_t p = cpu->p & ~(N_FLAG | V_FLAG | Z_FLAG | C_FLAG);
+	p |= cpu->nResult & N_FLAG;
+	p |= cpu->overflow ? V_FLAG : 0;
+	p |= cpu->zResult == 0 ? Z_FLAG : 0;
+	p |= cpu->carry;
+	return p;
+}
+
+void cpuSetP(uint8_t p) {
+	cpu->p = p;
+	cpu->nResult = p;
+	cpu->overflow = p & V_FLAG;
+	cpu->zResult = !(p & Z_FLAG);
+	cpu->carry = p & C_FLAG;
+}
+
+// most instructions set N and Z from the same value
+static inline void setNZ(uint8_t result) {
+	cpu->nResult = result;
+	cpu->zResult = result;
 }
 
 void cpuInit(void) {
-	cpu.pc = ADDR16(RST_VECTOR);
-	cpu.s = 0xFD;
-	cpu.p |= I_FLAG;
-	cpu.irq = 1;
-	cpu.nmi = 1;
+	cpu->pc = ADDR16(RST_VECTOR);
+	cpu->s = 0xFD;
+	cpu->p |= I_FLAG;
+	cpu->irq = 1;
+	cpu->nmi = 1;
 	return;
 }
 
 void push(uint8_t byte) {
-	ramWriteByte(0x100 + cpu.s, byte);
-	--cpu.s;
-	++cpu.cycles;
+	ramWriteByte(0x100 + cpu->s, byte);
+	--cpu->s;
+	++cpu->cycles;
 	return;
 }
 
 uint8_t pop(void) {
-	++cpu.s;
-	cpu.cycles += 2;
-	return ramReadByte(0x100 + cpu.s);
+	++cpu->s;
+	cpu->cycles += 2;
+	return ramReadByte(0x100 + cpu->s);
 }
 
 void branch(uint8_t cond, int8_t offset) {
 	if(cond) {
-		uint8_t oldPage = cpu.pc >> 8;
-		cpu.pc += (int8_t)offset;
-		if(cpu.pc>>8 != oldPage) { ++cpu.cycles; }
-		++cpu.cycles;
+		uint8_t oldPage = cpu->pc >> 8;
+		cpu->pc += (int8_t)offset;
+		if(cpu->pc>>8 != oldPage) { ++cpu->cycles; }
+		++cpu->cycles;
 	}
 	return;
 }
 
 void cmp(uint8_t reg, uint8_t byte) {
-	setFlag(C_FLAG, reg >= byte);
-	setFlag(Z_FLAG, reg == byte);
-	setFlag(N_FLAG, (reg - byte) & 0x80);
+	cpu->carry = reg >= byte;
+	setNZ(reg - byte);
 	return;
 }
 
 void bit(uint8_t byte) {
-	setFlag(Z_FLAG, (byte & cpu.a) == 0);
-	setFlag(V_FLAG, byte & V_FLAG);
-	setFlag(N_FLAG, byte & N_FLAG);
+	cpu->zResult = byte & cpu->a;
+	cpu->overflow = byte & V_FLAG;
+	cpu->nResult = byte;
 	return;
 }
 
 void ora(uint8_t byte) {
-	cpu.a |= byte;
-	setFlag(Z_FLAG, cpu.a == 0);
-	setFlag(N_FLAG, (cpu.a & 0x80) != 0);
+	cpu->a |= byte;
+	setNZ(cpu->a);
 	return;
 }
 
 void and_a(uint8_t byte) {
-	cpu.a &= byte;
-	setFlag(Z_FLAG, cpu.a == 0);
-	setFlag(N_FLAG, (cpu.a & 0x80) != 0);
+	cpu->a &= byte;
+	setNZ(cpu->a);
 	return;
 }
 
 void eor(uint8_t byte) {
-	cpu.a = cpu.a ^ byte;
-	setFlag(Z_FLAG, cpu.a == 0);
-	setFlag(N_FLAG, (cpu.a & 0x80) != 0);
+	cpu->a = cpu->a ^ byte;
+	setNZ(cpu->a);
 }
 
 // return result so it can be put into ram or A
 uint8_t asl(uint8_t byte) {
-	setFlag(C_FLAG, byte & 0x80);
+	cpu->carry = byte >> 7;
 	byte <<= 1;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, byte & 0x80);
+	setNZ(byte);
 	return byte;
 }
 
 uint8_t lsr(uint8_t byte) {
-	setFlag(C_FLAG, byte & 0x01);
+	cpu->carry = byte & 0x01;
 	byte >>= 1;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, byte & 0x80);
+	setNZ(byte);
 	return byte;
 }
 
 uint8_t ror(uint8_t byte) {
-	uint8_t carry = cpu.p & C_FLAG;
-	setFlag(C_FLAG, byte & 0x01);
+	uint8_t carry = cpu->carry;
+	cpu->carry = byte & 0x01;
 	byte >>= 1;
 	byte |= carry << 7;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, (byte & 0x80) != 0);
+	setNZ(byte);
 	return byte;
 }
 
 uint8_t rol(uint8_t byte) {
-	uint8_t carry = cpu.p & C_FLAG;
-	setFlag(C_FLAG, byte & 0x80);
+	uint8_t carry = cpu->carry;
+	cpu->carry = byte >> 7;
 	byte <<= 1;
 	byte |= carry;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, (byte & 0x80) != 0);
+	setNZ(byte);
 	return byte;
 }
 
 void adc(uint8_t byte) {
-	uint16_t tmp = cpu.a + byte + (cpu.p & C_FLAG);
+	uint16_t tmp = cpu->a + byte + cpu->carry;
 	uint8_t result = tmp & 0xFF;
-	//setFlag(V_FLAG, ((cpu.a & 0x80) ^ (byte & 0x80)) != (tmp & 0x80));
-	setFlag(V_FLAG, (result ^ cpu.a) & (result ^ byte) & 0x80);
-	cpu.a = result;
-	setFlag(C_FLAG, tmp > 255);
-	setFlag(Z_FLAG, cpu.a == 0);
-	setFlag(N_FLAG, (cpu.a & 0x80) != 0);
+	cpu->overflow = (result ^ cpu->a) & (result ^ byte) & 0x80;
+	cpu->a = result;
+	cpu->carry = tmp > 255;
+	setNZ(cpu->a);
 	return;
 }
 
 void sbc(uint8_t byte) {
-	int16_t tmp = cpu.a - byte - !(cpu.p & C_FLAG);
-	//setFlag(V_FLAG, ((cpu.a & 0x80) ^ (byte & 0x80)) != (tmp & 0x80));
+	int16_t tmp = cpu->a - byte - !cpu->carry;
 	uint8_t result = tmp & 0xFF;
-	setFlag(V_FLAG, (result ^ cpu.a) & (result ^ ~byte) & 0x80);
-	cpu.a = tmp & 0xFF;
-	setFlag(C_FLAG, !(tmp < 0));
-	setFlag(Z_FLAG, cpu.a == 0);
-	setFlag(N_FLAG, (cpu.a & 0x80) != 0);
+	cpu->overflow = (result ^ cpu->a) & (result ^ ~byte) & 0x80;
+	cpu->a = result;
+	cpu->carry = !(tmp < 0);
+	setNZ(cpu->a);
 }
 
 uint8_t dec(uint8_t byte) {
 	--byte;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, (byte & 0x80) != 0);
+	setNZ(byte);
 	return byte;
 }
 
 uint8_t inc(uint8_t byte) {
 	++byte;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, (byte & 0x80) != 0);
+	setNZ(byte);
 	return byte;
 }
 
 // using pointers here since I don't have to worry about affecting ram
 void load(uint8_t* reg, uint8_t byte) {
 	*reg = byte;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, (byte & 0x80) != 0);
+	setNZ(byte);
 	return;
 }
 
 void transfer(uint8_t* reg, uint8_t byte) {
 	*reg = byte;
-	setFlag(Z_FLAG, byte == 0);
-	setFlag(N_FLAG, (byte & 0x80) != 0);
+	setNZ(byte);
 	return;
 }
 
-uint8_t cpuStep(void) {
-	uint8_t opcode = ramReadByte(cpu.pc);
-	//cpuDumpState();
-	++cpu.pc;
-	cpu.cycles += 2;
-
-	// https://www.nesdev.org/wiki/CPU_unofficial_opcodes
-
-	// decoding the instructions like this might be slightly slower than just having the massive switch statement
-	// since I think the switch statement would just compile to a huge jump table
-	// but I haven't actually done any testing to see if that's the case
-
-	// cycle counts for unofficial opcodes probably wont be accurate
-
-	uint16_t addr;
-	uint8_t addrMode = opcode & 0x1F;
-	uint8_t instrType = opcode & 3;
-	switch(addrMode >> 2) {
-		case 0:
-			if(opcode == 0x20) {
-				// absolute (jsr)
-				addr = ABS_ADDR;
-				cpu.pc += 2;
-			} else if(instrType % 2 == 0) {
-				if(opcode >= 0x80) {
-					// immediate
-					addr = cpu.pc;
-					++cpu.pc;
-				} else {
-					// implicit
-					addr = 0;
-				}
-			} else {
-				// x indexed indirect
-				//addr = INDEX_INDIR_X_ADDR;
-				addr = ramReadByte((ARG8 + cpu.x) & 0xFF);
-				addr |= ramReadByte((ARG8 + cpu.x + 1) & 0xFF)<<8;
-				//ramWriteByte(addr, cpu.a);
-				++cpu.pc;
-				cpu.cycles += 4;
-			}
-			break;
-		case 1:
-			// zero page
-			addr = ramReadByte(cpu.pc);
-			++cpu.pc;
-			++cpu.cycles;
-			break;
-		case 2:
-			if(instrType % 2 == 0) {
-				// implicit
-				addr = 0;
-			} else {
-				// immediate
-				addr = cpu.pc;
-				++cpu.pc;
-			}
-			break;
-		case 3:
-			// absolute
-			addr = ABS_ADDR;
-			cpu.pc += 2;
-			if(opcode == 0x4C || opcode == 0x6C) {
-				// exception for jmp
-				++cpu.cycles;
-			} else {
-				cpu.cycles += 2;
-			}
-			break;
-		case 4:
-			switch(instrType) {
-				case 0:
-					// relative
-					addr = cpu.pc;
-					++cpu.pc;
-					break;
-				case 1:
-				case 3:
-					// indirect y indexed
-					//addr = INDIR_INDEX_Y_ADDR;
-					addr = ramReadByte(ARG8);
-					addr |= (ramReadByte((ARG8+1)&0xFF))<<8;
-					uint8_t startPage = addr >> 8;
-					addr += cpu.y;
-					++cpu.pc;
-					cpu.cycles += 3;
-					if(opcode == 0x91) {
-						++cpu.cycles; // hardcoded exception for sta
-					} else if(startPage != addr >> 8) {
-						++cpu.cycles;
-					}
-					break;
-				case 2:
-					// implicit (stp)
-					addr = 0;
-					break;
-			}
-			break;
-		case 5:
-			if(instrType > 1 && opcode > 0x80 && opcode < 0xC0) {
-				// zero page y indexed
-				addr = ZP_INDEX_ADDR(cpu.y);
-			} else {
-				// zero page x indexed
-				addr = ZP_INDEX_ADDR(cpu.x);
-			}
-			++cpu.pc;
-			cpu.cycles += 2;
-			break;
-		case 6:
-			if(instrType % 2 == 0) {
-				// implicit
-				addr = 0;
-			} else {
-				// absolute y indexed
-				addr = ABS_INDEX_ADDR(cpu.y);
-				uint8_t startPage = ABS_ADDR >> 8;
-				if(opcode == 0x99 || startPage != addr >> 8) {
-					++cpu.cycles;
-				}
-				cpu.pc += 2;
-				cpu.cycles += 2;
-			}
-			break;
-		case 7:
-			uint8_t startPage = ABS_ADDR >> 8;
-			if(instrType > 1 && opcode > 0x80 && opcode < 0xC0) {
-				// absolute y indexed
-				//addr = ABS_INDEX_ADDR(cpu.y);
-				addr = ramReadByte(cpu.pc);
-				addr += cpu.y;
-				if(addr >= 0x100) {
-					addr &= 0xFF;
-					addr |= ramReadByte(cpu.pc+1)<<8;
-					ramReadByte(addr);
-					addr += 0x100;
-				} else {
-					addr |= ramReadByte(cpu.pc+1)<<8;
-				}
-			} else {
-				// absolute x indexed
-				// dummy read
-				addr = ramReadByte(cpu.pc);
-				addr += cpu.x;
-				if(addr >= 0x100) {
-					addr &= 0xFF;
-					addr |= ramReadByte(cpu.pc+1)<<8;
-					ramReadByte(addr);
-					addr += 0x100;
-				} else {
-					addr |= ramReadByte(cpu.pc+1)<<8;
-				}
-				if(instrType == 2) {
-					++cpu.cycles;
-				}
-			}
-			cpu.pc += 2;
-			cpu.cycles += 2;
-			if(opcode == 0x9D || opcode == 0x99) {
-				++cpu.cycles; // hardcoded exception for sta
-			} else if((instrType != 2 || opcode == 0xBE) && startPage != addr >> 8) {
-				++cpu.cycles;
-			}
-			break;
+// https://www.nesdev.org/wiki/CPU_addressing_modes
+// operand is what was fetched after the opcode, pc already points past the whole instruction
+// each of these leaves the effective address in addr and returns 1 if indexing crossed a page
+static inline uint8_t addrIMP(uint16_t operand, uint16_t* addr) {
+	(void)operand;
+	*addr = 0;
+	return 0;
+}
+
+// immediate and relative operands get read by the instruction itself
+static inline uint8_t addrIMM(uint16_t operand, uint16_t* addr) {
+	(void)operand;
+	*addr = cpu->pc - 1;
+	return 0;
+}
+
+static inline uint8_t addrREL(uint16_t operand, uint16_t* addr) {
+	(void)operand;
+	*addr = cpu->pc - 1;
+	return 0;
+}
+
+static inline uint8_t addrZP0(uint16_t operand, uint16_t* addr) {
+	*addr = operand;
+	return 0;
+}
+
+static inline uint8_t addrZPX(uint16_t operand, uint16_t* addr) {
+	*addr = (operand + cpu->x) & 0xFF;
+	return 0;
+}
+
+static inline uint8_t addrZPY(uint16_t operand, uint16_t* addr) {
+	*addr = (operand + cpu->y) & 0xFF;
+	return 0;
+}
+
+static inline uint8_t addrABS(uint16_t operand, uint16_t* addr) {
+	*addr = operand;
+	return 0;
+}
+
+// does a dummy read from the unfixed address when the page is crossed
+static inline uint8_t absIndexed(uint16_t base, uint16_t* addr, uint8_t index) {
+	*addr = base + index;
+	if((base >> 8) != (*addr >> 8)) {
+		ramReadByte((base & 0xFF00) | (*addr & 0xFF));
+		return 1;
+	}
+	return 0;
+}
+
+static inline uint8_t addrABX(uint16_t operand, uint16_t* addr) {
+	return absIndexed(operand, addr, cpu->x);
+}
+
+// absolute y indexed for the instructions in the same column as abs,X ones (ldx, lax, shx, sha)
+// these get the same dummy read, the other abs,Y instructions don't
+static inline uint8_t addrABYD(uint16_t operand, uint16_t* addr) {
+	return absIndexed(operand, addr, cpu->y);
+}
+
+static inline uint8_t addrABY(uint16_t operand, uint16_t* addr) {
+	*addr = operand + cpu->y;
+	return (operand >> 8) != (*addr >> 8);
+}
+
+static inline uint8_t addrIZX(uint16_t operand, uint16_t* addr) {
+	uint8_t zp = operand + cpu->x;
+	*addr = ramReadByte(zp);
+	*addr |= ramReadByte((zp + 1) & 0xFF) << 8;
+	return 0;
+}
+
+static inline uint8_t addrIZY(uint16_t operand, uint16_t* addr) {
+	uint8_t zp = operand;
+	uint16_t base = ramReadByte(zp);
+	base |= ramReadByte((zp + 1) & 0xFF) << 8;
+	*addr = base + cpu->y;
+	return (base >> 8) != (*addr >> 8);
+}
+
+// instruction length and how many of the operand bytes get fetched before the instruction runs
+#define LENGTH_IMP 1
+#define LENGTH_IMM 2
+#define LENGTH_REL 2
+#define LENGTH_ZP0 2
+#define LENGTH_ZPX 2
+#define LENGTH_ZPY 2
+#define LENGTH_ABS 3
+#define LENGTH_ABX 3
+#define LENGTH_ABY 3
+#define LENGTH_ABYD 3
+#define LENGTH_IZX 2
+#define LENGTH_IZY 2
+
+#define FETCH_IMP 0
+#define FETCH_IMM 0
+#define FETCH_REL 0
+#define FETCH_ZP0 1
+#define FETCH_ZPX 1
+#define FETCH_ZPY 1
+#define FETCH_ABS 2
+#define FETCH_ABX 2
+#define FETCH_ABY 2
+#define FETCH_ABYD 2
+#define FETCH_IZX 1
+#define FETCH_IZY 1
+
+// push() and pop() count their own cycles for interrupts and nsf.c, instructions already have theirs in the cycle table
+static inline void stackPush(uint8_t byte) {
+	ramWriteByte(0x100 + cpu->s, byte);
+	--cpu->s;
+}
+
+static inline uint8_t stackPop(void) {
+	++cpu->s;
+	return ramReadByte(0x100 + cpu->s);
+}
+
+// https://www.nesdev.org/wiki/Instruction_reference
+static inline void opADC(uint16_t addr) { adc(ramReadByte(addr)); }
+static inline void opAND(uint16_t addr) { and_a(ramReadByte(addr)); }
+static inline void opASL(uint16_t addr) { ramWriteByte(addr, asl(ramReadByte(addr))); }
+static inline void opASL_A(uint16_t addr) { (void)addr; cpu->a = asl(cpu->a); }
+static inline void opBIT(uint16_t addr) { bit(ramReadByte(addr)); }
+static inline void opBPL(uint16_t addr) { branch((cpu->nResult & N_FLAG) == 0, ramReadByte(addr)); }
+static inline void opBMI(uint16_t addr) { branch((cpu->nResult & N_FLAG) != 0, ramReadByte(addr)); }
+static inline void opBVC(uint16_t addr) { branch(!cpu->overflow, ramReadByte(addr)); }
+static inline void opBVS(uint16_t addr) { branch(cpu->overflow, ramReadByte(addr)); }
+static inline void opBCC(uint16_t addr) { branch(!cpu->carry, ramReadByte(addr)); }
+static inline void opBCS(uint16_t addr) { branch(cpu->carry, ramReadByte(addr)); }
+static inline void opBNE(uint16_t addr) { branch(cpu->zResult != 0, ramReadByte(addr)); }
+static inline void opBEQ(uint16_t addr) { branch(cpu->zResult == 0, ramReadByte(addr)); }
+static inline void opCLC(uint16_t addr) { (void)addr; cpu->carry = 0; }
+static inline void opSEC(uint16_t addr) { (void)addr; cpu->carry = 1; }
+static inline void opCLI(uint16_t addr) { (void)addr; cpu->p &= ~(I_FLAG); }
+static inline void opSEI(uint16_t addr) { (void)addr; cpu->p |= I_FLAG; }
+static inline void opCLV(uint16_t addr) { (void)addr; cpu->overflow = 0; }
+static inline void opCLD(uint16_t addr) { (void)addr; cpu->p &= ~(D_FLAG); }
+static inline void opSED(uint16_t addr) { (void)addr; cpu->p |= D_FLAG; }
+static inline void opCMP(uint16_t addr) { cmp(cpu->a, ramReadByte(addr)); }
+static inline void opCPX(uint16_t addr) { cmp(cpu->x, ramReadByte(addr)); }
+static inline void opCPY(uint16_t addr) { cmp(cpu->y, ramReadByte(addr)); }
+static inline void opDEC(uint16_t addr) { ramWriteByte(addr, dec(ramReadByte(addr))); }
+static inline void opDEX(uint16_t addr) { (void)addr; cpu->x = dec(cpu->x); }
+static inline void opDEY(uint16_t addr) { (void)addr; cpu->y = dec(cpu->y); }
+static inline void opEOR(uint16_t addr) { eor(ramReadByte(addr)); }
+static inline void opINC(uint16_t addr) { ramWriteByte(addr, inc(ramReadByte(addr))); }
+static inline void opINX(uint16_t addr) { (void)addr; cpu->x = inc(cpu->x); }
+static inline void opINY(uint16_t addr) { (void)addr; cpu->y = inc(cpu->y); }
+static inline void opJMP(uint16_t addr) { cpu->pc = addr; }
+static inline void opLDA(uint16_t addr) { load(&cpu->a, ramReadByte(addr)); }
+static inline void opLDX(uint16_t addr) { load(&cpu->x, ramReadByte(addr)); }
+static inline void opLDY(uint16_t addr) { load(&cpu->y, ramReadByte(addr)); }
+static inline void opLSR(uint16_t addr) { ramWriteByte(addr, lsr(ramReadByte(addr))); }
+static inline void opLSR_A(uint16_t addr) { (void)addr; cpu->a = lsr(cpu->a); }
+static inline void opNOP(uint16_t addr) { (void)addr; }
+static inline void opORA(uint16_t addr) { ora(ramReadByte(addr)); }
+static inline void opPHA(uint16_t addr) { (void)addr; stackPush(cpu->a); }
+static inline void opPHP(uint16_t addr) { (void)addr; stackPush(cpuGetP() | B_FLAG | 0x20); }
+static inline void opPLA(uint16_t addr) { (void)addr; load(&cpu->a, stackPop()); }
+static inline void opPLP(uint16_t addr) { (void)addr; cpuSetP(stackPop()); }
+static inline void opROL(uint16_t addr) { ramWriteByte(addr, rol(ramReadByte(addr))); }
+static inline void opROL_A(uint16_t addr) { (void)addr; cpu->a = rol(cpu->a); }
+static inline void opROR(uint16_t addr) { ramWriteByte(addr, ror(ramReadByte(addr))); }
+static inline void opROR_A(uint16_t addr) { (void)addr; cpu->a = ror(cpu->a); }
+static inline void opSBC(uint16_t addr) { sbc(ramReadByte(addr)); }
+static inline void opSTA(uint16_t addr) { ramWriteByte(addr, cpu->a); }
+static inline void opSTX(uint16_t addr) { ramWriteByte(addr, cpu->x); }
+static inline void opSTY(uint16_t addr) { ramWriteByte(addr, cpu->y); }
+static inline void opTAX(uint16_t addr) { (void)addr; transfer(&cpu->x, cpu->a); }
+static inline void opTAY(uint16_t addr) { (void)addr; transfer(&cpu->y, cpu->a); }
+static inline void opTSX(uint16_t addr) { (void)addr; transfer(&cpu->x, cpu->s); }
+static inline void opTXA(uint16_t addr) { (void)addr; transfer(&cpu->a, cpu->x); }
+static inline void opTXS(uint16_t addr) { (void)addr; cpu->s = cpu->x; }
+static inline void opTYA(uint16_t addr) { (void)addr; transfer(&cpu->a, cpu->y); }
+
+static inline void opBRK(uint16_t addr) {
+	(void)addr;
+	++cpu->pc;
+	stackPush((cpu->pc & 0xFF00) >> 8);
+	stackPush(cpu->pc & 0xFF);
+	stackPush(cpuGetP() | B_FLAG | 0x20);
+	cpu->p |= I_FLAG;
+	cpu->pc = ADDR16(IRQ_VECTOR);
+}
+
+static inline void opJSR(uint16_t addr) {
+	--cpu->pc;
+	stackPush((cpu->pc & 0xFF00) >> 8);
+	stackPush(cpu->pc & 0xFF);
+	// hard coded to pass an accuracycoin test!!! not actually cycle accurate!!!!
+	// updates the ram for open bus!!!
+	ramReadByte(cpu->pc);
+	cpu->pc = addr;
+}
+
+static inline void opRTI(uint16_t addr) {
+	(void)addr;
+	cpuSetP(stackPop());
+	cpu->pc = stackPop();
+	cpu->pc |= stackPop()<<8;
+}
+
+static inline void opRTS(uint16_t addr) {
+	(void)addr;
+	cpu->pc = stackPop();
+	cpu->pc |= stackPop()<<8;
+	++cpu->pc;
+}
+
+static inline void opJMP_IND(uint16_t addr) {
+	uint16_t addr1 = addr;
+	if(((addr+1) & 0xFF) == 0xFF) {
+		addr1 -= 0x100;
+	}
+	uint16_t addr2 = ramReadByte(addr1) | ramReadByte(addr1+1)<<8;
+	if((addr1 & 0xFF) == 0xFF) {
+		addr2 = ramReadByte(addr1) | ramReadByte(addr1&0xFF00)<<8;
+	} else {
+		addr2 = ramReadByte(addr1) | ramReadByte(addr1+1)<<8;
+	}
+	cpu->pc = addr2;
+}
+
+// https://www.nesdev.org/wiki/CPU_unofficial_opcodes
+// nops that still read their operand
+static inline void opIGN(uint16_t addr) { ramReadByte(addr); }
+// doesn't actually halt the cpu
+static inline void opSTP(uint16_t addr) { (void)addr; }
+
+static inline void opSLO(uint16_t addr) {
+	ramWriteByte(addr, asl(ramReadByte(addr)));
+	ora(ramReadByte(addr));
+}
+
+static inline void opRLA(uint16_t addr) {
+	ramWriteByte(addr, rol(ramReadByte(addr)));
+	and_a(ramReadByte(addr));
+}
+
+static inline void opSRE(uint16_t addr) {
+	ramWriteByte(addr, lsr(ramReadByte(addr)));
+	eor(ramReadByte(addr));
+}
+
+static inline void opRRA(uint16_t addr) {
+	ramWriteByte(addr, ror(ramReadByte(addr)));
+	adc(ramReadByte(addr));
+}
+
+static inline void opDCP(uint16_t addr) {
+	ramWriteByte(addr, dec(ramReadByte(addr)));
+	cmp(cpu->a, ramReadByte(addr));
+}
+
+static inline void opISC(uint16_t addr) {
+	ramWriteByte(addr, inc(ramReadByte(addr)));
+	sbc(ramReadByte(addr));
+}
+
+static inline void opSAX(uint16_t addr) { ramWriteByte(addr, cpu->a & cpu->x); }
+
+static inline void opLAX(uint16_t addr) {
+	load(&cpu->a, ramReadByte(addr));
+	transfer(&cpu->x, cpu->a);
+}
+
+static inline void opLAS(uint16_t addr) {
+	load(&cpu->a, ramReadByte(addr) & cpu->s);
+	transfer(&cpu->x, cpu->a);
+	transfer(&cpu->s, cpu->x);
+}
+
+static inline void opANC(uint16_t addr) {
+	and_a(ramReadByte(addr));
+	cpu->carry = cpu->a >> 7;
+}
+
+static inline void opALR(uint16_t addr) {
+	and_a(ramReadByte(addr));
+	cpu->a = lsr(cpu->a);
+}
+
+static inline void opARR(uint16_t addr) {
+	and_a(ramReadByte(addr));
+	cpu->a = ror(cpu->a);
+	cpu->carry = (cpu->a >> 6) & 1;
+	cpu->overflow = ((cpu->a >> 6)&1) ^ ((cpu->a >> 5)&1);
+}
+
+static inline void opXAA(uint16_t addr) {
+	cpu->a = ((cpu->a | 0xEE) & cpu->x) & ramReadByte(addr);
+	setNZ(cpu->a);
+}
+
+static inline void opAXS(uint16_t addr) {
+	uint8_t value = ramReadByte(addr);
+	cpu->carry = (cpu->x&cpu->a) >= value;
+	cpu->x = (cpu->x&cpu->a) - value;
+	setNZ(cpu->x);
+}
+
+// these instructions are fucked up, just implementing it as like x&((addr>>8)+1) doesn't seem to be right
+// I don't want to reverse engineer accuracycoin's tests right now or peruse someone else's emulator's code for an answer
+// so these are still unimplemented for now
+static inline void opSHA(uint16_t addr) { (void)addr; }
+static inline void opSHS(uint16_t addr) { (void)addr; }
+static inline void opSHX(uint16_t addr) {
+	(void)addr;
+	//ramWriteByte(addr, cpu.x & ((addr>>8)+1));
+}
+static inline void opSHY(uint16_t addr) {
+	(void)addr;
+	//ramWriteByte(addr, cpu.y & ((addr>>8)+1));
+}
+
+// one handler per opcode, the addressing mode and instruction get inlined into each of them
+// returns 1 if indexing crossed a page
+#define OPCODE_HANDLER(code, instr, mode, cycles, pageCycles) \
+	static uint8_t opcode##code(uint16_t operand) { \
+		uint16_t addr; \
+		uint8_t pageCrossed = addr##mode(operand, &addr); \
+		op##instr(addr); \
+		return pageCrossed; \
 	}
-	switch(instrType) {
-		case 0:
-			// control instructions
-			// not really sure what the pattern is to most of these
-			if(((opcode & 0x1F) == 0x14 || (opcode & 0x1F) == 0x1C) && ((opcode & 0x80) == 0)) {
-				// nop
-				break;
-			}
-			switch(opcode) {
-				case 0x04:
-				case 0x0C:
-				case 0x44:
-				case 0x64:
-				case 0x80:
-					// nop
-					ramReadByte(addr);
-					break;
-				case 0x00:
-					// brk
-					++cpu.pc;
-					push((cpu.pc & 0xFF00) >> 8);
-					push(cpu.pc & 0xFF);
-					push(cpu.p | B_FLAG | 0x20);
-					cpu.p |= I_FLAG;
-					cpu.pc = ADDR16(IRQ_VECTOR);
-					cpu.cycles += 2;
-					break;
-				case 0x08:
-					// php
-					push(cpu.p | B_FLAG | 0x20);
-					break;
-				case 0x20:
-					// jsr
-					--cpu.pc;
-					push((cpu.pc & 0xFF00) >> 8);
-					push(cpu.pc & 0xFF);
-					// hard coded to pass an accuracycoin test!!! not actually cycle accurate!!!!
-					// updates the ram for open bus!!!
-					ramReadByte(cpu.pc);
-					cpu.pc = addr;
-					cpu.cycles += 2; // 6 total
-					break;
-				case 0x28:
-					// plp
-					cpu.p = pop();
-					break;
-				case 0x24:
-				case 0x2C:
-					// bit
-					bit(ramReadByte(addr));
-					break;
-				case 0x40:
-					// rti
-					cpu.p = pop();
-					cpu.pc = pop();
-					cpu.pc |= pop()<<8;
-					cpu.cycles = 6; // hardcoded exception, should be fixed
-					//cpu.cycles += 4;
-					break;
-				case 0x48:
-					// pha
-					push(cpu.a);
-					break;
-				case 0x4C:
-					// jmp
-					cpu.pc = addr;
-					break;
-				case 0x60:
-					// rts
-					cpu.pc = pop();
-					cpu.pc |= pop()<<8;
-					++cpu.pc;
-					//cpu.cycles += 4;
-					break;
-				case 0x68:
-					// pla
-					cpu.a = pop();
-					setFlag(Z_FLAG, cpu.a == 0);
-					setFlag(N_FLAG, (cpu.a & 0x80) != 0);
-					break;
-				case 0x6C:
-					// jmp indirect
-					uint16_t addr1 = addr;
-					if(((addr+1) & 0xFF) == 0xFF) {
-						addr1 -= 0x100;
-					}
-					uint16_t addr2 = ramReadByte(addr1) | ramReadByte(addr1+1)<<8;
-					if((addr1 & 0xFF) == 0xFF) {
-						addr2 = ramReadByte(addr1) | ramReadByte(addr1&0xFF00)<<8;
-					} else {
-						addr2 = ramReadByte(addr1) | ramReadByte(addr1+1)<<8;
-					}
-					cpu.pc = addr2;
-					cpu.cycles += 2;
-					break;
-				case 0x84:
-				case 0x8C:
-				case 0x94:
-					// sty
-					ramWriteByte(addr, cpu.y);
-					break;
-				case 0x88:
-					// dey
-					cpu.y = dec(cpu.y);
-					break;
-				case 0x98:
-					// tya
-					transfer(&cpu.a, cpu.y);
-					break;
-				case 0x9C:
-					// shy
-					//ramWriteByte(addr, cpu.y & ((addr >> 8)+1));
-					break;
-				case 0xA0:
-				case 0xA4:
-				case 0xAC:
-				case 0xB4:
-				case 0xBC:
-					// ldy
-					load(&cpu.y, ramReadByte(addr));
-					break;
-				case 0xA8:
-					// tay
-					transfer(&cpu.y, cpu.a);
-					break;
-				case 0xC0:
-				case 0xC4:
-				case 0xCC:
-					// cpy
-					cmp(cpu.y, ramReadByte(addr));
-					break;
-				case 0xC8:
-					// iny
-					cpu.y = inc(cpu.y);
-					break;
-				case 0xE0:
-				case 0xE4:
-				case 0xEC:
-					// cpx
-					cmp(cpu.x, ramReadByte(addr));
-					break;
-				case 0xE8:
-					// inx
-					cpu.x = inc(cpu.x);
-					break;
-
-				// branches
-				case 0x10:
-					// bpl
-					branch((cpu.p & N_FLAG) == 0, ramReadByte(addr));
-					break;
-				case 0x30:
-					// bmi
-					branch((cpu.p & N_FLAG) != 0, ramReadByte(addr));
-					break;
-				case 0x50:
-					// bvc
-					branch((cpu.p & V_FLAG) == 0, ramReadByte(addr));
-					break;
-				case 0x70:
-					// bvs
-					branch((cpu.p & V_FLAG) != 0, ramReadByte(addr));
-					break;
-				case 0x90:
-					// bcc
-					branch((cpu.p & C_FLAG) == 0, ramReadByte(addr));
-					break;
-				case 0xB0:
-					// bcs
-					branch((cpu.p & C_FLAG) != 0, ramReadByte(addr));
-					break;
-				case 0xD0:
-					// bne
-					branch((cpu.p & Z_FLAG) == 0, ramReadByte(addr));
-					break;
-				case 0xF0:
-					// beq
-					branch((cpu.p & Z_FLAG) != 0, ramReadByte(addr));
-					break;
-
-
-				// cpu flag stuff
-				case 0x18:
-					// clc
-					cpu.p &= ~(C_FLAG);
-					break;
-				case 0x38:
-					// sec
-					cpu.p |= C_FLAG;
-					break;
-				case 0x58:
-					// cli
-					cpu.p &= ~(I_FLAG);
-					break;
-				case 0x78:
-					// sei
-					cpu.p |= I_FLAG;
-					break;
-				case 0xB8:
-					// clv
-					cpu.p &= ~(V_FLAG);
-					break;
-				case 0xD8:
-					// cld
-					cpu.p &= ~(D_FLAG);
-					break;
-				case 0xF8:
-					// sed
-					cpu.p |= D_FLAG;
-					break;
-			}
-			break;
-		case 1:
-			// alu instructions
-			switch(opcode >> 4) {
-				case 0:
-				case 1:
-					// ora
-					ora(ramReadByte(addr));
-					break;
-				case 2:
-				case 3:
-					// and
-					and_a(ramReadByte(addr));
-					break;
-				case 4:
-				case 5:
-					// eor
-					eor(ramReadByte(addr));
-					break;
-				case 6:
-				case 7:
-					// adc
-					adc(ramReadByte(addr));
-					break;
-				case 8:
-				case 9:
-					// sta
-					if((opcode & 0x1F) != 0x09) {
-						ramWriteByte(addr, cpu.a);
-					}
-					break;
-				case 0xA:
-				case 0xB:
-					// lda
-					load(&cpu.a, ramReadByte(addr));
-					break;
-				case 0xC:
-				case 0xD:
-					// cmp
-					cmp(cpu.a, ramReadByte(addr));
-					break;
-				case 0xE:
-				case 0xF:
-					// sbc
-					sbc(ramReadByte(addr));
-					break;
-			}
-			break;
-		case 2:
-			// rmw instructions
-			if(addrMode == 0x12 || (addrMode == 0x02 && opcode < 0x80)) {
-				// stp
-			} else if(addrMode == 0x1A && (opcode < 0x80 || opcode > 0xC0)) {
-				// nop
-			} else {
-				switch(opcode >> 4) {
-					case 0x0:
-					case 0x1:
-						// asl
-						if((opcode & 0x1F) == 0x0A) {
-							cpu.a = asl(cpu.a);
-						} else {
-							ramWriteByte(addr, asl(ramReadByte(addr)));
-							cpu.cycles += 2;
-						}
-						break;
-					case 0x2:
-					case 0x3:
-						// rol
-						if((opcode & 0x1F) == 0x0A) {
-							cpu.a = rol(cpu.a);
-						} else {
-							ramWriteByte(addr, rol(ramReadByte(addr)));
-							cpu.cycles += 2;
-						}
-						break;
-					case 0x4:
-					case 0x5:
-						// lsr
-						if((opcode & 0x1F) == 0x0A) {
-							cpu.a = lsr(cpu.a);
-						} else {
-							ramWriteByte(addr, lsr(ramReadByte(addr)));
-							cpu.cycles += 2;
-						}
-						break;
-					case 0x6:
-					case 0x7:
-						// ror
-						if((opcode & 0x1F) == 0x0A) {
-							cpu.a = ror(cpu.a);
-						} else {
-							ramWriteByte(addr, ror(ramReadByte(addr)));
-							cpu.cycles += 2;
-						}
-						break;
-					case 0x8:
-					case 0x9:
-						switch(opcode & 0x1F) {
-							case 0x02:
-								// nop
-								break;
-							case 0x06:
-							case 0x0E:
-							case 0x16:
-								// stx
-								ramWriteByte(addr, cpu.x);
-								break;
-							case 0x0A:
-								// txa
-								transfer(&cpu.a, cpu.x);
-								break;
-							case 0x1A:
-								// txs
-								cpu.s = cpu.x;
-								break;
-							case 0x1E:
-								// shx (unimplemented)
-								//ramWriteByte(addr, cpu.x & (((addr>>8) + 1)&0xFF));
-								break;
-						}
-						break;
-					case 0xA:
-					case 0xB:
-						switch(opcode & 0x1F) {
-							case 0x02:
-							case 0x06:
-							case 0x0E:
-							case 0x16:
-							case 0x1E:
-								// ldx
-								load(&cpu.x, ramReadByte(addr));
-								break;
-							case 0x0A:
-								// tax
-								transfer(&cpu.x, cpu.a);
-								break;
-							case 0x1A:
-								// tsx
-								transfer(&cpu.x, cpu.s);
-								break;
-						}
-						break;
-					case 0xC:
-					case 0xD:
-						switch(opcode & 0x1F) {
-							case 0x02:
-							case 0x1A:
-								// nop
-								break;
-							case 0x06:
-							case 0x0E:
-							case 0x16:
-							case 0x1E:
-								// dec
-								ramWriteByte(addr, dec(ramReadByte(addr)));
-								cpu.cycles += 2;
-								break;
-							case 0x0A:
-								// dex
-								cpu.x = dec(cpu.x);
-								break;
-						}
-						break;
-					case 0xE:
-					case 0xF:
-						switch(opcode & 0x1F) {
-							case 0x02:
-							case 0x0A:
-							case 0x1A:
-								// nop
-								break;
-							case 0x06:
-							case 0x0E:
-							case 0x16:
-							case 0x1E:
-								// inc
-								ramWriteByte(addr, inc(ramReadByte(addr)));
-								cpu.cycles += 2;
-								break;
-						}
-						break;
-				}
-			}
-			break;
-		case 3:
-			// unofficial opcodes
-			if(addrMode == 0x0B) {
-				switch(opcode >> 5) {
-					case 0:
-					case 1:
-						// anc
-						and_a(ramReadByte(addr));
-						setFlag(C_FLAG, cpu.p & N_FLAG);
-						break;
-					case 2:
-						// alr
-						and_a(ramReadByte(addr));
-						cpu.a = lsr(cpu.a);
-						break;
-					case 3:
-						// arr
-						and_a(ramReadByte(addr));
-						cpu.a = ror(cpu.a);
-						setFlag(C_FLAG, cpu.a & (1<<6));
-						setFlag(V_FLAG, ((cpu.a >> 6)&1) ^ ((cpu.a >> 5)&1));
-						break;
-					case 4:
-						// xaa
-						cpu.a = ((cpu.a | 0xEE) & cpu.x) & ramReadByte(addr);
-						setFlag(Z_FLAG, cpu.a == 0);
-						setFlag(N_FLAG, (cpu.a & 0x80) != 0);
-						break;
-					case 5:
-						// lax
-						load(&cpu.a, ramReadByte(addr));
-						transfer(&cpu.x, cpu.a);
-						break;
-					case 6:
-						// axs
-						uint8_t value = ramReadByte(addr);
-						setFlag(C_FLAG, (cpu.x&cpu.a) >= value);
-						cpu.x = (cpu.x&cpu.a) - value;
-						setFlag(N_FLAG, cpu.x & 0x80);
-						setFlag(Z_FLAG, cpu.x == 0);
-						break;
-					case 7:
-						// sbc
-						sbc(ramReadByte(addr));
-						break;
-				}
-			} else if(opcode >> 4 == 9 && opcode != 0x97) {
-				// sh*
-				// these instructions are fucked up, just implementing it as like x&((addr>>8)+1) doesn't seem to be right
-				// I don't want to reverse engineer accuracycoin's tests right now or peruse someone else's emulator's code for an answer
-				// so these are still unimplemented for now
-				switch(opcode) {
-					/*case 0x93:
-					case 0x9f:
-						// sha
-						break;
-					case 0x9b:
-						// shs
-						break;*/
-					/*case 0x9c:
-						// shy
-						ramWriteByte(addr, cpu.y & ((addr>>8)+1));
-						break;
-					case 0x9e:
-						// shx
-						ramWriteByte(addr, cpu.x & ((addr>>8)+1));
-						break;*/
-					default:
-						//printf("sh* %02X\n", opcode);
-						break;
-				}
-			} else {
-				switch(opcode >> 5) {
-					case 0:
-						// slo
-						ramWriteByte(addr, asl(ramReadByte(addr)));
-						ora(ramReadByte(addr));
-						break;
-					case 1:
-						// rla
-						ramWriteByte(addr, rol(ramReadByte(addr)));
-						and_a(ramReadByte(addr));
-						break;
-					case 2:
-						// sre
-						ramWriteByte(addr, lsr(ramReadByte(addr)));
-						eor(ramReadByte(addr));
-						break;
-					case 3:
-						// rra
-						ramWriteByte(addr, ror(ramReadByte(addr)));
-						adc(ramReadByte(addr));
-						break;
-					case 4:
-						// sax
-						ramWriteByte(addr, cpu.a & cpu.x);
-						break;
-					case 5:
-						// lax
-						if(opcode == 0xbb) {
-							// lae
-							load(&cpu.a, ramReadByte(addr) & cpu.s);
-							transfer(&cpu.x, cpu.a);
-							transfer(&cpu.s, cpu.x);
-						} else {
-							load(&cpu.a, ramReadByte(addr));
-							transfer(&cpu.x, cpu.a);
-						}
-						break;
-					case 6:
-						// dcp
-						ramWriteByte(addr, dec(ramReadByte(addr)));
-						cmp(cpu.a, ramReadByte(addr));
-						break;
-					case 7:
-						// isc
-						ramWriteByte(addr, inc(ramReadByte(addr)));
-						sbc(ramReadByte(addr));
-						break;
-				}
-			}
-			break;
+OPCODES(OPCODE_HANDLER)
+
+#define OPCODE_HANDLER_ENTRY(code, instr, mode, cycles, pageCycles) [code] = opcode##code,
+static uint8_t (*const opcodeHandlers[256])(uint16_t operand) = {
+	OPCODES(OPCODE_HANDLER_ENTRY)
+};
+
+#define OPCODE_CYCLES_ENTRY(code, instr, mode, cycles, pageCycles) [code] = cycles,
+static const uint8_t opcodeCycles[256] = {
+	OPCODES(OPCODE_CYCLES_ENTRY)
+};
+
+#define OPCODE_PAGE_CYCLES_ENTRY(code, instr, mode, cycles, pageCycles) [code] = pageCycles,
+static const uint8_t opcodePageCycles[256] = {
+	OPCODES(OPCODE_PAGE_CYCLES_ENTRY)
+};
+
+#define OPCODE_LENGTH_ENTRY(code, instr, mode, cycles, pageCycles) [code] = LENGTH_##mode,
+static const uint8_t opcodeLengths[256] = {
+	OPCODES(OPCODE_LENGTH_ENTRY)
+};
+
+#define OPCODE_FETCH_ENTRY(code, instr, mode, cycles, pageCycles) [code] = FETCH_##mode,
+static const uint8_t opcodeFetches[256] = {
+	OPCODES(OPCODE_FETCH_ENTRY)
+};
+
+// fetches the instruction at pc through the bus
+// it's saved in code if the page has one so next time it runs none of this has to be done again
+// not static so it doesn't get inlined and slow down cpuStep's cached path
+cpuDecoded_t cpuDecode(cpuDecoded_t* code) {
+	cpuDecoded_t op;
+	uint8_t opcode = ramReadByte(cpu->pc);
+	op.handler = opcodeHandlers[opcode];
+	op.cycles = opcodeCycles[opcode];
+	op.pageCycles = opcodePageCycles[opcode];
+	op.length = opcodeLengths[opcode];
+	op.operand = 0;
+	op.lastByte = opcode;
+	op.jitState = 0;
+	if(opcodeFetches[opcode] >= 1) {
+		op.lastByte = ramReadByte(cpu->pc + 1);
+		op.operand = op.lastByte;
+	}
+	if(opcodeFetches[opcode] == 2) {
+		op.lastByte = ramReadByte(cpu->pc + 2);
+		op.operand |= op.lastByte << 8;
 	}
 
-	if(!(cpu.p & I_FLAG) && cpu.irq == 0) {
-		push((cpu.pc & 0xFF00) >> 8);
-		push(cpu.pc & 0xFF);
-		push((cpu.p & ~(B_FLAG)) | 0x20);
-		cpu.p |= I_FLAG;
-		cpu.pc = ADDR16(IRQ_VECTOR);
+	// instructions running into the next page don't get saved since that page can be switched out on its own
+	if(code && (cpu->pc & 0xFF) + op.length <= 0x100) {
+		code[cpu->pc & 0xFF] = op;
+		ramProtectCode(cpu->pc);
 	}
-	cpu.irq = 1;
-
-	if(cpu.nmi == 0) {
-		push((cpu.pc & 0xFF00) >> 8);
-		push(cpu.pc & 0xFF);
-		push((cpu.p & ~(B_FLAG)) | 0x20);
-		cpu.p |= I_FLAG;
-		cpu.pc = ADDR16(NMI_VECTOR);
+	return op;
+}
+
+// decodes the instruction at pc straight out of its page without going through the bus, used by the jit
+// returns the opcode, or -1 if the page isn't mapped straight to memory or the instruction runs into the next page
+int16_t cpuPeekInstruction(uint16_t pc, cpuDecoded_t* op) {
+	uint8_t* page = ram->readPages[pc >> 8];
+	if(!page) {
+		return -1;
 	}
-	cpu.nmi = 1;
+	uint8_t opcode = page[pc & 0xFF];
+	op->handler = opcodeHandlers[opcode];
+	op->cycles = opcodeCycles[opcode];
+	op->pageCycles = opcodePageCycles[opcode];
+	op->length = opcodeLengths[opcode];
+	if((pc & 0xFF) + op->length > 0x100) {
+		return -1;
+	}
+	op->operand = 0;
+	op->lastByte = opcode;
+	op->jitState = 0;
+	if(opcodeFetches[opcode] >= 1) {
+		op->lastByte = page[(pc & 0xFF) + 1];
+		op->operand = op->lastByte;
+	}
+	if(opcodeFetches[opcode] == 2) {
+		op->lastByte = page[(pc & 0xFF) + 2];
+		op->operand |= op->lastByte << 8;
+	}
+	return opcode;
+}
 
-	/*static uint8_t cycles[256][5] = {0};
-	if(cycles[opcode][cpu.cycles - 2] == 0) {
-		cycles[opcode][cpu.cycles - 2] = 1;
-		printf("%02X: %i\n", opcode, cpu.cycles);
-	}*/
+uint8_t cpuStep(void) {
+	cpuDecoded_t* code = ram->codePages[cpu->pc >> 8];
+	cpuDecoded_t* op = code ? &code[cpu->pc & 0xFF] : NULL;
+	cpuDecoded_t decoded;
+	if(op && op->handler) {
+		ram->dataBus = op->lastByte;
+	} else {
+		decoded = cpuDecode(code);
+		op = &decoded;
+	}
+	//cpuDumpState();
+	cpu->pc += op->length;
+
+	// the instruction could write over its own page and clear op, so everything needed after it runs is read first
+	uint8_t pageCycles = op->pageCycles;
+	cpu->cycles += op->cycles;
+	if(op->handler(op->operand)) {
+		cpu->cycles += pageCycles;
+	}
+
+	if(!(cpu->p & I_FLAG) && cpu->irq == 0) {
+		push((cpu->pc & 0xFF00) >> 8);
+		push(cpu->pc & 0xFF);
+		push((cpuGetP() & ~(B_FLAG)) | 0x20);
+		cpu->p |= I_FLAG;
+		cpu->pc = ADDR16(IRQ_VECTOR);
+	}
+	cpu->irq = 1;
+
+	if(cpu->nmi == 0) {
+		push((cpu->pc & 0xFF00) >> 8);
+		push(cpu->pc & 0xFF);
+		push((cpuGetP() & ~(B_FLAG)) | 0x20);
+		cpu->p |= I_FLAG;
+		cpu->pc = ADDR16(NMI_VECTOR);
+	}
+	cpu->nmi = 1;
 
 	return 0;
 }
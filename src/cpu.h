@@ -23,19 +23,44 @@ typedef struct {
 	uint8_t y;
 	uint16_t pc;
 	uint8_t s;
+	// only I, D and B are up to date in p, use cpuGetP() for the whole status byte
 	uint8_t p;
+	// N is bit 7 of nResult, Z is set when zResult is 0
+	uint8_t nResult;
+	uint8_t zResult;
+	uint8_t carry;
+	uint8_t overflow;
 	uint8_t irq;
 	uint8_t nmi;
 	uint64_t cycles;
 } cpu_t;
 
-extern cpu_t cpu;
+// every module keeps its state in a struct inside nes_t (nes.h), these point at the one for whichever console
+// the current thread is running, set by nesBind()
+extern __thread cpu_t* cpu;
+
+// an instruction that's already been fetched, saved for code in memory mapped straight into the cpu's pages
+typedef struct {
+	uint8_t (*handler)(uint16_t operand);
+	uint16_t operand;
+	uint8_t cycles;
+	uint8_t pageCycles;
+	uint8_t length;
+	// last byte of the instruction that got fetched, the data bus needs to end up the same as if it was read again
+	uint8_t lastByte;
+	// how hot this is as the start of a block for the jit
+	uint8_t jitState;
+} cpuDecoded_t;
+
+uint8_t cpuGetP(void);
+void cpuSetP(uint8_t p);
 
 void push(uint8_t byte);
 uint8_t pop(void);
 
 void cpuInit(void);
 uint8_t cpuStep(void);
+int16_t cpuPeekInstruction(uint16_t pc, cpuDecoded_t* op);
 
 void cpuDumpState(void);
 
@@ -1,5 +1,8 @@
 #include "debug.h"
 
+// there's nothing to draw on in the headless build, debug.h has drawDebugText() do nothing instead
+#ifndef HEADLESS
+
 #include <stdio.h>
 #include <stdarg.h>
 
@@ -78,3 +81,5 @@ void uninitDebugRenderer(void) {
 void toggleDebugInfo(void) {
 	debugEnabled = !debugEnabled;
 }
+
+#endif
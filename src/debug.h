@@ -2,7 +2,11 @@
 #define DEBUG_H
 
 #include <stdarg.h>
+#include <stdint.h>
 
+#ifdef HEADLESS
+static inline void drawDebugText(uint16_t x, uint16_t y, char* fmt, ...) { (void)x; (void)y; (void)fmt; }
+#else
 #include "SDL3/SDL.h"
 
 void initDebugRenderer(void);
@@ -10,5 +14,6 @@ void drawDebugText(uint16_t x, uint16_t y, char* fmt, ...);
 void renderDebugInfo(SDL_Surface* windowSurface);
 
 void toggleDebugInfo(void);
+#endif
 
 #endif // DEBUG_H
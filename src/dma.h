@@ -8,10 +8,17 @@ enum {
 	DMA_CYCLE_GET = 1,
 };
 
-extern uint8_t dmaCycle;
+typedef struct {
+	uint8_t cycle;
+	uint8_t active;
 
+	// oam dma
+	uint8_t oamPage;
+	uint16_t oamIndex;
+	uint8_t retrievedOamByte;
+} dma_t;
 
-extern uint8_t dmaActive;
+extern __thread dma_t* dma;
 
 void dmaStep(void);
 void oamDMAStart(uint8_t page);
@@ -8,6 +8,7 @@
 #include "ram.h"
 #include "ppu.h"
 #include "rom.h"
+#include "tiles.h"
 
 // https://www.nesdev.org/wiki/INES
 typedef struct {
@@ -66,13 +67,13 @@ typedef struct {
 uint8_t loadROM(const char* path) {
 	FILE* f = fopen(path, "rb");
 	if(!f) {
-		printf("could not find file \"%s\"\n", path);
+		romLog("could not find file \"%s\"\n", path);
 		return 1;
 	}
 
 	fseek(f, 0, SEEK_END);
 	size_t fileSize = ftell(f);
-	printf("%lu\n", fileSize);
+	romLog("%lu\n", fileSize);
 	fseek(f, 0, SEEK_SET);
 
 	uint8_t* fileBuffer = malloc(fileSize);
@@ -81,81 +82,98 @@ uint8_t loadROM(const char* path) {
 
 	fclose(f);
 
-	if(strncmp((char*)fileBuffer, "NESM\x1A", 5) == 0) {
+	uint8_t result = loadROMFromMemory(fileBuffer, fileSize);
+	free(fileBuffer);
+	return result;
+}
+
+// everything it needs gets copied out of fileBuffer, so it can be freed once this returns
+uint8_t loadROMFromMemory(const uint8_t* fileBuffer, size_t fileSize) {
+	if(fileSize < 16) {
+		romLog("invalid header\n");
+		return 1;
+	}
+
+	if(strncmp((const char*)fileBuffer, "NESM\x1A", 5) == 0) {
 		// nsf
-		rom.isNSF = 1;
-		nsfHeader* header = (nsfHeader*)fileBuffer;
+		if(fileSize < 0x80) {
+			romLog("invalid header\n");
+			return 1;
+		}
+		rom->isNSF = 1;
+		const nsfHeader* header = (const nsfHeader*)fileBuffer;
 		/*for(uint8_t i = 0; i < 8; ++i) {
 			if(header->bankSwitchValues[i] != 0) {
-				printf("nsf bankswitching unimplemented\n");
+				romLog("nsf bankswitching unimplemented\n");
 				exit(1);
 			}
 		}*/
-		printf("song name: %s\n", header->songName);
-		printf("author name: %s\n", header->songAuthor);
-
-		memcpy(rom.nsfSongName, header->songName, 32);
-		memcpy(rom.nsfSongAuthor, header->songAuthor, 32);
-		memcpy(rom.nsfSongCopyright, header->songCopyright, 32);
-		rom.nsfLoadAddr = (header->dataLoadHigh << 8) | header->dataLoadLow;
-		rom.nsfInitAddr = (header->dataInitHigh << 8) | header->dataInitLow;
-		rom.nsfPlayAddr = (header->dataPlayHigh << 8) | header->dataPlayLow;
-		rom.nsfSpeed = (header->playSpeedHigh << 8) | header->playSpeedLow;
-
-		rom.prgSize = fileSize-0x80 + (rom.nsfLoadAddr - 0x8000);
-		rom.chrSize = 0x2000;
-		rom.prgROM = malloc(rom.prgSize);
-		rom.chrROM = malloc(rom.chrSize);
+		romLog("song name: %s\n", header->songName);
+		romLog("author name: %s\n", header->songAuthor);
+
+		memcpy(rom->nsfSongName, header->songName, 32);
+		memcpy(rom->nsfSongAuthor, header->songAuthor, 32);
+		memcpy(rom->nsfSongCopyright, header->songCopyright, 32);
+		rom->nsfLoadAddr = (header->dataLoadHigh << 8) | header->dataLoadLow;
+		rom->nsfInitAddr = (header->dataInitHigh << 8) | header->dataInitLow;
+		rom->nsfPlayAddr = (header->dataPlayHigh << 8) | header->dataPlayLow;
+		rom->nsfSpeed = (header->playSpeedHigh << 8) | header->playSpeedLow;
+
+		rom->prgSize = fileSize-0x80 + (rom->nsfLoadAddr - 0x8000);
+		rom->chrSize = 0x2000;
+		rom->prgROM = malloc(rom->prgSize);
+		rom->chrROM = malloc(rom->chrSize);
+		rom->chrMemSize = rom->chrSize;
+		tilesInit(rom->chrSize);
 		// there's something to do with padding shenanigans specifically if the nsf file uses bank switching
 		// not gonna deal with that for now lmao, I don't have any nsf files that do that to test it with right now
-		memcpy(rom.prgROM + rom.nsfLoadAddr - 0x8000, fileBuffer+0x80, fileSize-0x80);
+		memcpy(rom->prgROM + rom->nsfLoadAddr - 0x8000, fileBuffer+0x80, fileSize-0x80);
 		setNSFMapper(header->bankSwitchValues, header->audioExpansion);
 
-		free(fileBuffer);
 		return 0;
 	}
 
-	if(strncmp((char*)fileBuffer, "NES\x1A", 4) != 0) {
-		printf("invalid header\n");
+	if(strncmp((const char*)fileBuffer, "NES\x1A", 4) != 0) {
+		romLog("invalid header\n");
 		return 1;
 	}
 
 	// common between formats
-	ppu.mirror = fileBuffer[6] & 0x1;
+	ppuSetMirroring(fileBuffer[6] & 0x1);
 	if(fileBuffer[6] & 0x02) {
-		printf("battery backed PRG RAM, unsupported\n");
+		romLog("battery backed PRG RAM, unsupported\n");
 	}
 
-	uint8_t* prgLocation;
-	uint8_t* chrLocation;
-	rom.prgSize = 0;
-	rom.chrSize = 0;
+	const uint8_t* prgLocation;
+	const uint8_t* chrLocation;
+	rom->prgSize = 0;
+	rom->chrSize = 0;
 	size_t chrRAMSize = 0;
 	uint16_t mapperID;
 
 	if((fileBuffer[7] & 0x0C) == 0x08) {
-		printf("NES 2.0 rom\n");
-		nes2Header* header = (nes2Header*)fileBuffer;
+		romLog("NES 2.0 rom\n");
+		const nes2Header* header = (const nes2Header*)fileBuffer;
 
-		printf("timing: %02X\n", header->timing & 0x3);
+		romLog("timing: %02X\n", header->timing & 0x3);
 
 		if((header->romSizeMSB & 0xF) == 0xF) {
 			// exponent notation
 			uint8_t mult = (header->prgSizeLSB & 0x3)*2 + 1;
 			uint8_t exponent = header->prgSizeLSB >> 2;
-			rom.prgSize = (1<<exponent) * mult;
+			rom->prgSize = (1<<exponent) * mult;
 		} else {
-			rom.prgSize = (((header->romSizeMSB & 0xF) << 8) | header->prgSizeLSB) * 0x4000;  
+			rom->prgSize = (((header->romSizeMSB & 0xF) << 8) | header->prgSizeLSB) * 0x4000;  
 		}
 
 		if((header->romSizeMSB & 0xF0) == 0xF0) {
 			// exponent notation
 			uint8_t mult = (header->chrSizeLSB & 0x3)*2 + 1;
 			uint8_t exponent = header->chrSizeLSB >> 2;
-			rom.chrSize = (1<<exponent) * mult;
+			rom->chrSize = (1<<exponent) * mult;
 		} else {
 			// already shifted by 4
-			rom.chrSize = (((header->romSizeMSB & 0xF0) << 4) | header->chrSizeLSB) * 0x2000;  
+			rom->chrSize = (((header->romSizeMSB & 0xF0) << 4) | header->chrSizeLSB) * 0x2000;  
 		}
 
 		if((header->chrRAMSize & 0xF) != 0) {
@@ -166,47 +184,56 @@ uint8_t loadROM(const char* path) {
 		// still need to implement the msb for mapper ids and submapper ids
 		mapperID = ((header->flags6 & 0xF0) >> 4) | ((header->flags7 & 0xF0));
 	} else {
-		iNESHeader* header = (iNESHeader*)fileBuffer;
+		const iNESHeader* header = (const iNESHeader*)fileBuffer;
 
 		mapperID = ((header->flags6 & 0xF0) >> 4) | ((header->flags7 & 0xF0));
 
-		rom.prgSize = header->prgSize * 0x4000;
-		rom.chrSize = header->chrSize * 0x2000;
+		rom->prgSize = header->prgSize * 0x4000;
+		rom->chrSize = header->chrSize * 0x2000;
 
-		if(rom.chrSize == 0) {
+		if(rom->chrSize == 0) {
 			chrRAMSize = 0x2000;
 		}
 	}
-	printf("PRG ROM size: %luk\n", rom.prgSize / 0x400);
-	printf("CHR ROM size: %luk\n", rom.chrSize / 0x400);
-	printf("CHR RAM size: %luk\n", chrRAMSize / 0x400);
-	printf("mirror: %02X\n", ppu.mirror);
-	printf("mapper ID: %02X\n", mapperID);
-
-	setMapper(mapperID);
+	romLog("PRG ROM size: %luk\n", rom->prgSize / 0x400);
+	romLog("CHR ROM size: %luk\n", rom->chrSize / 0x400);
+	romLog("CHR RAM size: %luk\n", chrRAMSize / 0x400);
+	romLog("mirror: %02X\n", ppu->mirror);
+	romLog("mapper ID: %02X\n", mapperID);
 
 	prgLocation = fileBuffer+16;
 	if(fileBuffer[6] & 0x04) {
-		printf("trainer in rom\n");
+		romLog("trainer in rom\n");
 		prgLocation += 512;
 	}
-	chrLocation = prgLocation + rom.prgSize;
+	chrLocation = prgLocation + rom->prgSize;
+	if((size_t)(chrLocation - fileBuffer) + rom->chrSize > fileSize) {
+		romLog("rom is smaller than its header says\n");
+		return 1;
+	}
 
-	if(rom.prgSize != 0) {
-		rom.prgROM = malloc(rom.prgSize);
-		memcpy(rom.prgROM, prgLocation, rom.prgSize);
+	if(rom->prgSize != 0) {
+		rom->prgROM = malloc(rom->prgSize);
+		memcpy(rom->prgROM, prgLocation, rom->prgSize);
+		ramAddCodeRegion(rom->prgROM, rom->prgSize);
 	}
-	if(rom.chrSize != 0) {
-		rom.chrROM = malloc(rom.chrSize);
-		memcpy(rom.chrROM, chrLocation, rom.chrSize);
+	if(rom->chrSize != 0) {
+		rom->chrROM = malloc(rom->chrSize);
+		memcpy(rom->chrROM, chrLocation, rom->chrSize);
+		rom->chrMemSize = rom->chrSize;
+		tilesInit(rom->chrSize);
 	} else if(chrRAMSize != 0) {
-		rom.chrROM = malloc(chrRAMSize); // there's probably some things that bank switch between chr rom and chr ram, this needs to be fixed
+		rom->chrROM = calloc(chrRAMSize, 1); // zeroed so every console starts the same, there's probably some things that bank switch between chr rom and chr ram, this needs to be fixed
+		rom->chrMemSize = chrRAMSize;
+		tilesInit(chrRAMSize);
 	}
 
-	free(fileBuffer);
-
+	// mappers set up their prg pages, so this needs the rom to be loaded first
+	if(setMapper(mapperID) != 0) {
+		return 1;
+	}
 
-	printf("\n\n");
+	romLog("\n\n");
 
 	return 0;
 }
@@ -2,7 +2,9 @@
 #define FILES_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 uint8_t loadROM(const char* path);
+uint8_t loadROMFromMemory(const uint8_t* fileBuffer, size_t fileSize);
 
 #endif
@@ -0,0 +1,155 @@
+#include "frontend.h"
+
+// the headless build has no window, this is all left out of it
+#ifndef HEADLESS
+
+#include "SDL3/SDL.h"
+
+#include <stdio.h>
+
+#include "ppu.h"
+#include "apu.h"
+#include "input.h"
+#include "debug.h"
+
+SDL_Window* w;
+SDL_Surface* windowSurface;
+
+// the emulation draws into frames[backFrame] and the front end shows frames[frontFrame], nothing else touches those two
+// finished frames get swapped into the middle slot, which has FRAME_NEW set until the front end takes what's there
+frame_t frames[3];
+SDL_Surface* frameSurfaces[3];
+uint8_t backFrame = 0;
+uint8_t frontFrame = 1;
+SDL_AtomicInt middleFrame;
+#define FRAME_NEW 4
+
+int (*emulationMain)(void* data);
+SDL_AtomicInt emulationRunning;
+
+#ifdef BENCHMARK
+uint8_t fpsUncap = 1;
+#else
+uint8_t fpsUncap = 0;
+#endif
+
+uint8_t frontendInit(void) {
+	if(SDL_Init(SDL_INIT_VIDEO) == 0) {
+		printf("could not init SDL\n");
+		return 1;
+	}
+
+	w = SDL_CreateWindow("nesEmu", SCREEN_WIDTH, SCREEN_HEIGHT, 0);
+	windowSurface = SDL_GetWindowSurface(w);
+	for(uint8_t i = 0; i < 3; ++i) {
+		frameSurfaces[i] = SDL_CreateSurfaceFrom(FB_WIDTH, FB_HEIGHT, SDL_PIXELFORMAT_RGBA8888, frames[i].pixels, FB_WIDTH*sizeof(uint32_t));
+	}
+	SDL_SetAtomicInt(&middleFrame, 2);
+	ppu->frame = &frames[backFrame];
+	ppu->frameDone = render;
+
+	initDebugRenderer();
+
+	return 0;
+}
+
+void frontendUninit(void) {
+	for(uint8_t i = 0; i < 3; ++i) {
+		SDL_DestroySurface(frameSurfaces[i]);
+	}
+	SDL_DestroyWindowSurface(w);
+	SDL_DestroyWindow(w);
+
+	SDL_Quit();
+}
+
+void frontendPublishFrame(void) {
+	backFrame = SDL_SetAtomicInt(&middleFrame, backFrame | FRAME_NEW) & 3;
+	ppu->frame = &frames[backFrame];
+}
+
+void frontendPresent(void) {
+	if(ppu->indexedOutput) {
+		ppuIndexedToRGBA(&frames[frontFrame]);
+	}
+	SDL_BlitSurfaceScaled(frameSurfaces[frontFrame], &(SDL_Rect){0,0,FB_WIDTH,FB_HEIGHT}, windowSurface, &(SDL_Rect){0,0,SCREEN_WIDTH,SCREEN_HEIGHT}, SDL_SCALEMODE_NEAREST);
+
+	// the debug text gets drawn from the emulation thread, so it can tear, but it's only for debugging
+	renderDebugInfo(windowSurface);
+	SDL_UpdateWindowSurface(w);
+}
+
+int frontendEmulationThread(void* data) {
+	int ret = emulationMain(data);
+	SDL_SetAtomicInt(&emulationRunning, 0);
+	return ret;
+}
+
+void frontendRun(int (*emulate)(void* data), void* data) {
+	emulationMain = emulate;
+	SDL_SetAtomicInt(&emulationRunning, 1);
+	SDL_Thread* emulation = SDL_CreateThread(frontendEmulationThread, "emulation", data);
+	if(emulation == NULL) {
+		printf("could not create the emulation thread, \"%s\"\n", SDL_GetError());
+		return;
+	}
+
+	// the emulation stops once it sees handleInput() wanting to quit
+	while(SDL_GetAtomicInt(&emulationRunning)) {
+		handleInput();
+		if(SDL_GetAtomicInt(&middleFrame) & FRAME_NEW) {
+			frontFrame = SDL_SetAtomicInt(&middleFrame, frontFrame) & 3;
+			frontendPresent();
+		} else {
+			SDL_DelayNS(1000000);
+		}
+	}
+
+	SDL_WaitThread(emulation, NULL);
+}
+
+void frontendScreenshot(void) {
+	SDL_SaveBMP(frameSurfaces[frontFrame], "framebuffer.bmp");
+}
+
+// ppu.frameDone for the window, hands the finished frame over to be shown, then keeps the emulation from going faster than 60fps
+// skipped frames don't get shown or waited on, that's what makes frame skipping fast forward
+void render(void) {
+	apuPrintDebug();
+	if(ppu->skipFrame) {
+		return;
+	}
+	frontendPublishFrame();
+
+	#ifdef BENCHMARK
+	// prints how many frames get rendered a second with the fps cap off
+	static uint64_t benchmarkTicks = 0;
+	static uint32_t benchmarkFrames = 0;
+	if(benchmarkTicks == 0) {
+		benchmarkTicks = SDL_GetTicksNS();
+	} else if(++benchmarkFrames == 120) {
+		uint64_t ticks = SDL_GetTicksNS();
+		printf("%.1f fps\n", benchmarkFrames * 1000000000.0 / (ticks - benchmarkTicks));
+		benchmarkTicks = ticks;
+		benchmarkFrames = 0;
+	}
+	#endif
+
+	if(!fpsUncap) {
+		static uint64_t lastTicks = 0;
+		if(lastTicks == 0) {
+			lastTicks = SDL_GetTicksNS();
+		}
+		uint64_t currentTicks = SDL_GetTicksNS();
+		if(currentTicks - lastTicks < 1000000000/60) {
+			SDL_DelayNS(1000000000/60 - (currentTicks - lastTicks));
+		}
+		lastTicks = SDL_GetTicksNS();
+	}
+}
+
+void toggleFPSCap(void) {
+	fpsUncap = !fpsUncap;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef FRONTEND_H
+#define FRONTEND_H
+
+#include <stdint.h>
+
+// https://en.wikipedia.org/wiki/Multiple_buffering#Triple_buffering
+// the emulation runs on its own thread and hands every finished frame to the front end through a triple buffer,
+// the front end stays on the main thread (SDL wants video and events there) and owns the window, events and presenting
+// neither side ever waits on the other, a slow present just means the front end skips to the newest frame
+
+uint8_t frontendInit(void);
+void frontendUninit(void);
+
+// called by the emulation thread once ppu.frame is finished, ppu.frame gets pointed at the next one to draw
+void frontendPublishFrame(void);
+
+// runs the emulation on its own thread with emulate(data) and presents frames until either the window gets closed or emulate returns
+void frontendRun(int (*emulate)(void* data), void* data);
+
+void frontendScreenshot(void);
+
+void render(void);
+void toggleFPSCap(void);
+
+#endif
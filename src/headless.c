@@ -0,0 +1,107 @@
+#include "headless.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nes.h"
+
+uint32_t headlessFrames;
+uint32_t headlessFramesRun;
+uint8_t* headlessInput;
+long headlessInputSize;
+FILE* headlessAudio;
+
+uint8_t headlessPoll(void) {
+	input->controllers[0].buttons = (headlessFramesRun < headlessInputSize ? headlessInput[headlessFramesRun] : 0);
+	return 0;
+}
+
+void headlessFrameDone(void) {
+	if(headlessAudio) {
+		fwrite(apu->samples, sizeof(float), apu->sampleCount, headlessAudio);
+	}
+	apu->sampleCount = 0;
+	if(++headlessFramesRun >= headlessFrames) {
+		scheduler->quit = 1;
+	}
+}
+
+uint8_t* headlessReadFile(const char* path, long* size) {
+	FILE* f = fopen(path, "rb");
+	if(f == NULL) {
+		printf("could not open %s\n", path);
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t* data = malloc(*size > 0 ? *size : 1);
+	if(*size > 0 && fread(data, *size, 1, f) != 1) {
+		printf("could not read %s\n", path);
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+uint8_t headlessWriteFile(const char* path, const void* data, size_t size) {
+	FILE* f = fopen(path, "wb");
+	if(f == NULL || fwrite(data, size, 1, f) != 1) {
+		printf("could not write %s\n", path);
+		if(f) { fclose(f); }
+		return 1;
+	}
+	fclose(f);
+	return 0;
+}
+
+uint8_t headlessRun(uint32_t frames, const char* inputPath, const char* framePath, const char* audioPath, const char* ramPath) {
+	if(rom->isNSF) {
+		printf("nsf files can't be run headless\n");
+		return 1;
+	}
+
+	headlessFrames = frames;
+	headlessFramesRun = 0;
+	headlessInput = NULL;
+	headlessInputSize = 0;
+	headlessAudio = NULL;
+	if(inputPath) {
+		headlessInput = headlessReadFile(inputPath, &headlessInputSize);
+		if(headlessInput == NULL) { return 1; }
+	}
+	if(audioPath) {
+		headlessAudio = fopen(audioPath, "wb");
+		if(headlessAudio == NULL) {
+			printf("could not open %s\n", audioPath);
+			free(headlessInput);
+			return 1;
+		}
+	}
+
+	input->poll = headlessPoll;
+	ppu->frameDone = headlessFrameDone;
+	cpuInit();
+	schedulerInit();
+	if(frames > 0) {
+		nesMain();
+	}
+
+	uint8_t ret = 0;
+	if(framePath) {
+		if(ppu->indexedOutput) {
+			ret |= headlessWriteFile(framePath, ppu->frame->indexed, sizeof(ppu->frame->indexed));
+		} else {
+			ret |= headlessWriteFile(framePath, ppu->frame->pixels, sizeof(ppu->frame->pixels));
+		}
+	}
+	if(ramPath) {
+		ret |= headlessWriteFile(ramPath, ram->cpuRAM, sizeof(ram->cpuRAM));
+	}
+	if(headlessAudio) {
+		fclose(headlessAudio);
+	}
+	free(headlessInput);
+	return ret;
+}
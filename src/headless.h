@@ -0,0 +1,17 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdint.h>
+
+// reads a whole file into a buffer that has to be freed, prints why and returns NULL if it can't
+uint8_t* headlessReadFile(const char* path, long* size);
+
+// runs the bound console for frames frames on the calling thread with no window, audio device or anything else from SDL
+// a frame ends at the start of vblank, so everything gets dumped right as the last one is finished
+// inputPath is a file with a byte of controller 1's buttons for each frame (see controller_t), they all get let go once it runs out
+// framePath gets the last frame drawn, frame_t's pixels as they are in memory or its indexed bytes with ppu.indexedOutput set
+// audioPath gets every sample as 32 bit floats at SAMPLE_RATE, ramPath gets the 2k of cpu ram
+// any of the paths can be NULL, returns 0 if everything went fine
+uint8_t headlessRun(uint32_t frames, const char* inputPath, const char* framePath, const char* audioPath, const char* ramPath);
+
+#endif // HEADLESS_H
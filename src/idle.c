@@ -0,0 +1,125 @@
+#include "idle.h"
+
+#include "ram.h"
+#include "ppu.h"
+#include "opcodes.h"
+#include "scheduler.h"
+
+__thread idle_t* idle;
+
+// which modes read from an address that's known without running the loop
+#define IDLE_ACCESS_IMP 0
+#define IDLE_ACCESS_IMM 0
+#define IDLE_ACCESS_REL 0
+#define IDLE_ACCESS_ZP0 1
+#define IDLE_ACCESS_ZPX 1
+#define IDLE_ACCESS_ZPY 1
+#define IDLE_ACCESS_ABS 2
+#define IDLE_ACCESS_ABX 3
+#define IDLE_ACCESS_ABY 3
+#define IDLE_ACCESS_ABYD 3
+#define IDLE_ACCESS_IZX 3
+#define IDLE_ACCESS_IZY 3
+
+#define IDLE_ACCESS_ENTRY(code, instr, mode, cycles, pageCycles) [code] = IDLE_ACCESS_##mode,
+static const uint8_t idleAccess[256] = {
+	OPCODES(IDLE_ACCESS_ENTRY)
+};
+
+// instructions that only change registers, anything writing memory, touching the stack or I can't be in an idle loop
+#define IDLE_ALLOWED_ENTRY(code, instr, mode, cycles, pageCycles) [code] = (INSTR_CLASS_##instr & CLASS_REGISTERS) != 0,
+static const uint8_t idleAllowedTable[256] = {
+	OPCODES(IDLE_ALLOWED_ENTRY)
+};
+
+// pc just jumped backwards from end, checks if everything from there to end could be an idle loop and starts watching it
+void idleFound(uint16_t end) {
+	idle->length = -1;
+	if(cpu->pc == idle->rejectedHead && end == idle->rejectedEnd) {
+		return;
+	}
+	uint8_t pollsStatus = 0;
+	uint16_t pc = cpu->pc;
+	int16_t opcode = -1;
+	while(pc <= end) {
+		cpuDecoded_t op;
+		opcode = cpuPeekInstruction(pc, &op);
+		if(opcode < 0 || !idleAllowedTable[opcode]) {
+			break;
+		}
+		uint8_t access = opcode == 0x4C ? 0 : idleAccess[opcode];
+		if(access == 2) {
+			// ram and anything mapped straight to memory can only change by being written to
+			if((op.operand & 0xE007) == 0x2002) {
+				pollsStatus = 1;
+			} else if(op.operand >= 0x2000 && !ram->readPages[op.operand >> 8]) {
+				break;
+			}
+		} else if(access == 3) {
+			break;
+		}
+		if(pc == end) {
+			break;
+		}
+		pc += op.length;
+	}
+	// the loop has to end exactly on the branch or jmp back to head
+	// (all the branches are xxx10000, 0x4C is jmp absolute)
+	if(pc != end || opcode < 0 || ((opcode & 0x1F) != 0x10 && opcode != 0x4C)) {
+		idle->rejectedHead = cpu->pc;
+		idle->rejectedEnd = end;
+		return;
+	}
+	idle->head = cpu->pc;
+	idle->length = end - cpu->pc;
+	idle->pollsStatus = pollsStatus;
+	idle->elapsed = 0;
+	idle->a = cpu->a;
+	idle->x = cpu->x;
+	idle->y = cpu->y;
+	idle->s = cpu->s;
+	idle->p = cpuGetP();
+}
+
+// how many cycles from the start of the current instruction until something could change what the loop reads
+uint32_t idleHorizon(void) {
+	if(scheduler->next <= scheduler->cpuTime) {
+		return 0;
+	}
+	uint64_t horizon = scheduler->next - scheduler->cpuTime;
+	if(idle->pollsStatus) {
+		uint32_t status = ppuCyclesUntilStatusChange();
+		if(status < horizon) {
+			horizon = status;
+		}
+	}
+	return horizon > UINT32_MAX ? UINT32_MAX : horizon;
+}
+
+// pc is back at the head of the loop being watched
+void idleLoop(void) {
+	uint8_t p = cpuGetP();
+	if(cpu->a != idle->a || cpu->x != idle->x || cpu->y != idle->y || cpu->s != idle->s || p != idle->p) {
+		idle->a = cpu->a;
+		idle->x = cpu->x;
+		idle->y = cpu->y;
+		idle->s = cpu->s;
+		idle->p = p;
+		idle->elapsed = 0;
+		return;
+	}
+	// nothing changed over the last iteration, so every one after it goes exactly the same until something outside the cpu changes
+	uint64_t period = idle->elapsed;
+	idle->elapsed = 0;
+	// the ppu needs to be caught up to where the instruction that just ran started to know what it'll do next
+	schedulerSync();
+	uint32_t horizon = idleHorizon();
+	if(horizon <= cpu->cycles) {
+		return;
+	}
+	horizon -= cpu->cycles;
+	// the iteration that gets to the change has to actually run, so stop a whole one before it
+	if(horizon >= period*2) {
+		cpu->cycles += (horizon/period - 1) * period;
+	}
+}
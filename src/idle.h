@@ -0,0 +1,54 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+// https://www.nesdev.org/wiki/The_frame_and_NMIs
+// games usually wait for the next frame by spinning on $2002 or on a byte in ram that their nmi handler changes
+// loops like that which don't write anything get skipped ahead whole iterations at a time up until
+// the next thing that could change what they read
+
+// longest loop in bytes that gets looked at
+#define IDLE_MAX_LENGTH 32
+
+typedef struct {
+	// first instruction of the loop being watched, pc stays between head and head+length while it runs
+	// length is -1 when there isn't a loop being watched
+	uint16_t head;
+	int32_t length;
+	uint8_t pollsStatus;
+	// registers the last time pc was at head
+	uint8_t a;
+	uint8_t x;
+	uint8_t y;
+	uint8_t s;
+	uint8_t p;
+	// cycles since pc was last at head
+	uint64_t elapsed;
+	// last loop that wasn't idle so it doesn't get looked at every time it loops
+	uint16_t rejectedHead;
+	uint16_t rejectedEnd;
+} idle_t;
+
+extern __thread idle_t* idle;
+
+void idleFound(uint16_t end);
+void idleLoop(void);
+
+// call after every instruction with the pc it started from, before cpu.cycles is used up
+static inline void idleTrack(uint16_t lastPC) {
+	if((uint16_t)(cpu->pc - idle->head) <= idle->length) {
+		idle->elapsed += cpu->cycles;
+		if(cpu->pc == idle->head) {
+			idleLoop();
+		}
+	} else if(cpu->pc < lastPC && lastPC - cpu->pc < IDLE_MAX_LENGTH) {
+		idleFound(lastPC);
+	} else {
+		idle->length = -1;
+	}
+}
+
+#endif
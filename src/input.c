@@ -1,29 +1,25 @@
 #include "input.h"
 
-#include "SDL3/SDL.h"
+#ifndef HEADLESS
+	#include "SDL3/SDL.h"
+#endif
 
 #include "ppu.h"
 #include "cpu.h"
 #include "ram.h"
 
 #include "debug.h"
+#include "frontend.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 
-controller_t controllers[2];
-
-uint8_t controllerLatch;
-int keyNumber;
-const uint8_t* keys;
-uint8_t* keysLastFrame;
-
-SDL_Event e;
+__thread input_t* input;
 
 uint8_t pollController(uint8_t port) {
-	controller_t* c = &controllers[port];
+	controller_t* c = &input->controllers[port];
 
-	if(controllerLatch) {
+	if(input->controllerLatch) {
 		c->shiftRegister = c->buttons;
 		return c->shiftRegister & 0x1;
 	}
@@ -34,16 +30,42 @@ uint8_t pollController(uint8_t port) {
 	return ret;
 }
 
+// for when whatever's running the console sets input.controllers itself
+uint8_t inputNoPoll(void) {
+	return 0;
+}
+
+// the keyboard and window events are only there with SDL
+#ifndef HEADLESS
+int keyNumber;
+const uint8_t* keys;
+uint8_t* keysLastFrame;
+
+SDL_Event e;
+
+// handleInput() runs on the front end's thread, it leaves the controller and anything that has to touch the emulation here for inputPoll()
+SDL_AtomicInt inputButtons;
+SDL_AtomicInt inputRequests;
+SDL_AtomicInt inputQuit;
+
+enum {
+	INPUT_REQUEST_RESET = 1,
+	INPUT_REQUEST_DUMP = 2,
+	INPUT_REQUEST_FPS_CAP = 4,
+};
+
 void initInput(void) {
 	keys = (const uint8_t*)SDL_GetKeyboardState(&keyNumber); 
 	keysLastFrame = malloc(sizeof(uint8_t) * keyNumber); // memory leak of like maybe 200 bytes because I don't care enough to free it lmao
 	memset(keysLastFrame, 0, sizeof(uint8_t) * keyNumber);
+	input->poll = inputPoll;
 }
 
 uint8_t handleInput(void) {
-	SDL_PollEvent(&e);
-	if(e.type == SDL_EVENT_QUIT) {
-		return 1;
+	while(SDL_PollEvent(&e)) {
+		if(e.type == SDL_EVENT_QUIT) {
+			SDL_SetAtomicInt(&inputQuit, 1);
+		}
 	}
 	const SDL_Keycode inputKeys[] = {
 		SDL_SCANCODE_Z, // A
@@ -55,16 +77,16 @@ uint8_t handleInput(void) {
 		SDL_SCANCODE_LEFT,
 		SDL_SCANCODE_RIGHT,
 	};
+	uint8_t buttons = 0;
 	for(uint8_t i = 0; i < 8; ++i) {
 		if(keys[inputKeys[i]]) {
-			controllers[0].buttons |= 1 << i;
-		} else {
-			controllers[0].buttons &= ~(1 << i);
+			buttons |= 1 << i;
 		}
 	}
+	SDL_SetAtomicInt(&inputButtons, buttons);
 
 	if(keys[SDL_SCANCODE_P]) {
-		debugScreenshot();
+		frontendScreenshot();
 		exit(1);
 	}
 
@@ -72,21 +94,47 @@ uint8_t handleInput(void) {
 		toggleDebugInfo();
 	}
 
+	int requests = 0;
 	if(keys[SDL_SCANCODE_F1] && !keysLastFrame[SDL_SCANCODE_F1]) {
-		cpuDumpState();
+		requests |= INPUT_REQUEST_DUMP;
 	}
 
 	if(keys[SDL_SCANCODE_TAB] && !keysLastFrame[SDL_SCANCODE_TAB]) {
-		toggleFPSCap();
+		requests |= INPUT_REQUEST_FPS_CAP;
 	}
 
 
 	if(keys[SDL_SCANCODE_R]) {
-		cpu.pc = ADDR16(RST_VECTOR);
+		requests |= INPUT_REQUEST_RESET;
+	}
+
+	if(requests) {
+		int old;
+		do {
+			old = SDL_GetAtomicInt(&inputRequests);
+		} while(!SDL_CompareAndSwapAtomicInt(&inputRequests, old, old | requests));
 	}
 
 	memcpy(keysLastFrame, keys, sizeof(uint8_t) * keyNumber);
-	SDL_PumpEvents();
 
-	return 0;
+	return SDL_GetAtomicInt(&inputQuit);
+}
+
+// called by the emulation once a frame to pick up what handleInput() left for it
+uint8_t inputPoll(void) {
+	input->controllers[0].buttons = SDL_GetAtomicInt(&inputButtons);
+
+	int requests = SDL_SetAtomicInt(&inputRequests, 0);
+	if(requests & INPUT_REQUEST_DUMP) {
+		cpuDumpState();
+	}
+	if(requests & INPUT_REQUEST_FPS_CAP) {
+		toggleFPSCap();
+	}
+	if(requests & INPUT_REQUEST_RESET) {
+		cpu->pc = ADDR16(RST_VECTOR);
+	}
+
+	return SDL_GetAtomicInt(&inputQuit);
 }
+#endif
@@ -4,17 +4,31 @@
 #include <stdint.h>
 
 typedef struct {
+	// https://www.nesdev.org/wiki/Standard_controller
+	// a bit for each button in the order they get read, A, B, select, start, up, down, left, right from bit 0 up
 	uint8_t buttons;
 	uint8_t shiftRegister;
 } controller_t;
 
-extern uint8_t controllerLatch;
+typedef struct {
+	controller_t controllers[2];
+	uint8_t controllerLatch;
+	// called at the start of every frame to update the controllers, returns 1 to stop the emulation
+	uint8_t (*poll)(void);
+} input_t;
 
-extern controller_t controllers[2];
+extern __thread input_t* input;
 
 uint8_t pollController(uint8_t port);
+uint8_t inputNoPoll(void);
 
+#ifndef HEADLESS
+// points the bound console's input.poll at the keyboard
 void initInput(void);
+// handleInput() pumps events on the front end's thread, inputPoll() applies them on the emulation's
+// both return 1 once the window's been closed
 uint8_t handleInput(void);
+uint8_t inputPoll(void);
+#endif
 
 #endif
@@ -0,0 +1,748 @@
+// needed for mmap's MAP_ANONYMOUS and sysconf() with -std=c99
+#define _DEFAULT_SOURCE
+#include "jit.h"
+
+#ifdef JIT
+
+#if !defined(__x86_64__) || !defined(__unix__)
+#error "the jit only supports x86-64 unix"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ram.h"
+#include "ppu.h"
+#include "apu.h"
+#include "opcodes.h"
+#include "scheduler.h"
+
+// blocks are a run of instructions in one 256 byte page, up to and including the first one that jumps
+// loads, stores and compares on immediates and zero page, transfers, increments, flag changes and branches
+// become x86 that works on cpu_t and ram straight away, keeping the flags the same lazy way cpu.c does
+// everything else becomes a call to the interpreter's own handler for it
+// either way the fetching, dispatch, cycle counting and interrupt polling of cpuStep() are done in the translated code around it
+
+#define JIT_MIN_INSTRUCTIONS 3
+#define JIT_CODE_SIZE (16 << 20)
+// worst case size of one translated instruction, and of a whole block
+#define JIT_MAX_INSTRUCTION 128
+#define JIT_MAX_BLOCK (JIT_MAX_INSTRUCTION * 256 + 64)
+
+__thread jit_t* jit;
+
+enum {
+	MODE_IMP,
+	MODE_IMM,
+	MODE_REL,
+	MODE_ZP0,
+	MODE_ZPX,
+	MODE_ZPY,
+	MODE_ABS,
+	MODE_ABX,
+	MODE_ABY,
+	MODE_ABYD,
+	MODE_IZX,
+	MODE_IZY,
+};
+
+#define JIT_MODE_ENTRY(code, instr, mode, cycles, pageCycles) [code] = MODE_##mode,
+static const uint8_t jitModes[256] = {
+	OPCODES(JIT_MODE_ENTRY)
+};
+
+#define JIT_INSTRUCTION_ENTRY(code, instr, mode, cycles, pageCycles) [code] = INSTR_##instr,
+static const uint8_t jitInstructions[256] = {
+	OPCODES(JIT_INSTRUCTION_ENTRY)
+};
+
+#define JIT_CLASS_ENTRY(code, instr, mode, cycles, pageCycles) [code] = INSTR_CLASS_##instr,
+static const uint8_t jitClasses[256] = {
+	OPCODES(JIT_CLASS_ENTRY)
+};
+
+enum {
+	JIT_READS = 0x01,
+	JIT_WRITES = 0x02,
+	JIT_ENDS_BLOCK = 0x04,
+	JIT_JMP_IND = 0x08,
+	// CLI, PLP and RTI can clear I, blocks only run while IRQs are masked
+	JIT_INTERPRET = 0x10,
+};
+
+uint8_t jitFlags[256];
+
+// instructions that get written out as x86 instead of calling their handler
+enum {
+	JIT_CALL,
+	JIT_NOP,
+	JIT_LOAD,
+	JIT_STORE,
+	JIT_TRANSFER,
+	// TXS, the only transfer that doesn't set N and Z
+	JIT_MOVE,
+	JIT_INCREMENT,
+	JIT_DECREMENT,
+	JIT_SET_FLAG,
+	JIT_COMPARE,
+	JIT_LOGIC,
+	JIT_BRANCH,
+	JIT_JUMP,
+};
+
+typedef struct {
+	uint8_t kind;
+	// offsets into cpu_t of the register read and the one written
+	uint8_t src;
+	uint8_t dst;
+	// SET_FLAG: the value it's set to
+	// LOGIC: the x86 opcode for op al, imm8, op r/m8, r8 is 4 below it
+	// BRANCH: the bits of src that get tested
+	uint8_t value;
+	// BRANCH: taken when those bits aren't 0
+	uint8_t takenIfSet;
+} jitInline_t;
+
+#define JIT_REG(field) offsetof(cpu_t, field)
+// anything not in here calls its handler
+static const jitInline_t jitInlineInstructions[INSTR_COUNT] = {
+	[INSTR_NOP] = {JIT_NOP, 0, 0, 0, 0},
+	[INSTR_LDA] = {JIT_LOAD, 0, JIT_REG(a), 0, 0},
+	[INSTR_LDX] = {JIT_LOAD, 0, JIT_REG(x), 0, 0},
+	[INSTR_LDY] = {JIT_LOAD, 0, JIT_REG(y), 0, 0},
+	[INSTR_STA] = {JIT_STORE, JIT_REG(a), 0, 0, 0},
+	[INSTR_STX] = {JIT_STORE, JIT_REG(x), 0, 0, 0},
+	[INSTR_STY] = {JIT_STORE, JIT_REG(y), 0, 0, 0},
+	[INSTR_TAX] = {JIT_TRANSFER, JIT_REG(a), JIT_REG(x), 0, 0},
+	[INSTR_TAY] = {JIT_TRANSFER, JIT_REG(a), JIT_REG(y), 0, 0},
+	[INSTR_TXA] = {JIT_TRANSFER, JIT_REG(x), JIT_REG(a), 0, 0},
+	[INSTR_TYA] = {JIT_TRANSFER, JIT_REG(y), JIT_REG(a), 0, 0},
+	[INSTR_TSX] = {JIT_TRANSFER, JIT_REG(s), JIT_REG(x), 0, 0},
+	[INSTR_TXS] = {JIT_MOVE, JIT_REG(x), JIT_REG(s), 0, 0},
+	[INSTR_INX] = {JIT_INCREMENT, 0, JIT_REG(x), 0, 0},
+	[INSTR_INY] = {JIT_INCREMENT, 0, JIT_REG(y), 0, 0},
+	[INSTR_DEX] = {JIT_DECREMENT, 0, JIT_REG(x), 0, 0},
+	[INSTR_DEY] = {JIT_DECREMENT, 0, JIT_REG(y), 0, 0},
+	[INSTR_CLC] = {JIT_SET_FLAG, 0, JIT_REG(carry), 0, 0},
+	[INSTR_SEC] = {JIT_SET_FLAG, 0, JIT_REG(carry), 1, 0},
+	[INSTR_CLV] = {JIT_SET_FLAG, 0, JIT_REG(overflow), 0, 0},
+	[INSTR_CMP] = {JIT_COMPARE, JIT_REG(a), 0, 0, 0},
+	[INSTR_CPX] = {JIT_COMPARE, JIT_REG(x), 0, 0, 0},
+	[INSTR_CPY] = {JIT_COMPARE, JIT_REG(y), 0, 0, 0},
+	[INSTR_AND] = {JIT_LOGIC, JIT_REG(a), JIT_REG(a), 0x24, 0},
+	[INSTR_ORA] = {JIT_LOGIC, JIT_REG(a), JIT_REG(a), 0x0C, 0},
+	[INSTR_EOR] = {JIT_LOGIC, JIT_REG(a), JIT_REG(a), 0x34, 0},
+	[INSTR_BPL] = {JIT_BRANCH, JIT_REG(nResult), 0, N_FLAG, 0},
+	[INSTR_BMI] = {JIT_BRANCH, JIT_REG(nResult), 0, N_FLAG, 1},
+	[INSTR_BVC] = {JIT_BRANCH, JIT_REG(overflow), 0, 0xFF, 0},
+	[INSTR_BVS] = {JIT_BRANCH, JIT_REG(overflow), 0, 0xFF, 1},
+	[INSTR_BCC] = {JIT_BRANCH, JIT_REG(carry), 0, 0xFF, 0},
+	[INSTR_BCS] = {JIT_BRANCH, JIT_REG(carry), 0, 0xFF, 1},
+	[INSTR_BNE] = {JIT_BRANCH, JIT_REG(zResult), 0, 0xFF, 1},
+	[INSTR_BEQ] = {JIT_BRANCH, JIT_REG(zResult), 0, 0xFF, 0},
+	[INSTR_JMP] = {JIT_JUMP, 0, 0, 0, 0},
+};
+
+static jitInline_t jitInlines[256];
+
+// only the addressing modes that don't need anything looked up at runtime
+static uint8_t jitInlineMode(uint8_t kind, uint8_t mode) {
+	switch(kind) {
+		case JIT_NOP:
+			return mode == MODE_IMP || mode == MODE_IMM;
+		case JIT_LOAD:
+		case JIT_COMPARE:
+		case JIT_LOGIC:
+			return mode == MODE_IMM || mode == MODE_ZP0;
+		case JIT_STORE:
+			return mode == MODE_ZP0;
+		case JIT_BRANCH:
+			return mode == MODE_REL;
+		case JIT_JUMP:
+			return mode == MODE_ABS;
+		default:
+			return mode == MODE_IMP;
+	}
+}
+
+void jitInitFlags(void) {
+	for(uint16_t i = 0; i < 256; ++i) {
+		uint8_t classes = jitClasses[i];
+		uint8_t flags = 0;
+		if(jitModes[i] >= MODE_ZP0 && !(classes & CLASS_NO_ACCESS)) {
+			flags |= classes & CLASS_WRITES ? JIT_WRITES : JIT_READS;
+		}
+		if(classes & CLASS_JUMPS) {
+			flags |= JIT_ENDS_BLOCK;
+		}
+		if(jitInstructions[i] == INSTR_JMP_IND) {
+			flags = JIT_ENDS_BLOCK | JIT_JMP_IND;
+		}
+		if(classes & CLASS_CLEARS_I) {
+			flags |= JIT_INTERPRET;
+		}
+		jitFlags[i] = flags;
+
+		jitInlines[i] = jitInlineInstructions[jitInstructions[i]];
+		if(!jitInlineMode(jitInlines[i].kind, jitModes[i])) {
+			jitInlines[i].kind = JIT_CALL;
+		}
+	}
+}
+
+// checks done by translated code before an instruction with an address that's only known at runtime
+// anything that isn't mapped straight to memory (registers, mapper writes, protected code) gets left to cpuStep()
+static uint8_t jitDirect(uint16_t addr, uint8_t write) {
+	if(write) {
+		return ram->writePages[addr >> 8] != NULL;
+	}
+	return ram->readPages[addr >> 8] != NULL;
+}
+
+static uint8_t jitGuardABX(uint16_t operand, uint8_t write) {
+	return jitDirect(operand + cpu->x, write);
+}
+
+static uint8_t jitGuardABY(uint16_t operand, uint8_t write) {
+	return jitDirect(operand + cpu->y, write);
+}
+
+// reads the pointer straight from zero page so the data bus doesn't change if the check fails
+static uint8_t jitGuardIZX(uint16_t operand, uint8_t write) {
+	uint8_t zp = operand + cpu->x;
+	uint16_t addr = ram->readPages[0][zp] | ram->readPages[0][(zp + 1) & 0xFF] << 8;
+	return jitDirect(addr, write);
+}
+
+static uint8_t jitGuardIZY(uint16_t operand, uint8_t write) {
+	uint8_t zp = operand;
+	uint16_t base = ram->readPages[0][zp] | ram->readPages[0][(zp + 1) & 0xFF] << 8;
+	return jitDirect(base + cpu->y, write);
+}
+
+// https://www.felixcloutier.com/x86/
+static void emit8(uint8_t byte) {
+	*jit->out++ = byte;
+}
+
+static void emit16(uint16_t value) {
+	memcpy(jit->out, &value, 2);
+	jit->out += 2;
+}
+
+static void emit32(uint32_t value) {
+	memcpy(jit->out, &value, 4);
+	jit->out += 4;
+}
+
+static void emit64(uint64_t value) {
+	memcpy(jit->out, &value, 8);
+	jit->out += 8;
+}
+
+// rel32 jump or conditional jump to target, opcode is 0xE9 or the second byte of a 0x0F jcc
+static void emitJump(uint8_t opcode, uint8_t* target) {
+	if(opcode != 0xE9) {
+		emit8(0x0F);
+	}
+	emit8(opcode);
+	emit32((uint32_t)(int32_t)(target - (jit->out + 4)));
+}
+
+// mov rax, fn; call rax
+static void emitCall(uint64_t fn) {
+	emit8(0x48);
+	emit8(0xB8);
+	emit64(fn);
+	emit8(0xFF);
+	emit8(0xD0);
+}
+
+// the zero page operand of an instruction, read through r13 which points at ram.dataBus
+// mov reg, [r13 + cpuRAM + zp]; mov [r13], reg with reg being al (0) or cl (1)
+static void emitReadZP(uint8_t reg, uint8_t zp) {
+	emit8(0x41); emit8(0x8A); emit8(0x85 | reg << 3);
+	emit32((uint32_t)(int32_t)(offsetof(ram_t, cpuRAM) - offsetof(ram_t, dataBus) + zp));
+	emit8(0x41); emit8(0x88); emit8(0x45 | reg << 3); emit8(0x00);
+}
+
+// mov [r13 + cpuRAM + zp], al; mov [r13], al
+static void emitWriteZP(uint8_t zp) {
+	emit8(0x41); emit8(0x88); emit8(0x85);
+	emit32((uint32_t)(int32_t)(offsetof(ram_t, cpuRAM) - offsetof(ram_t, dataBus) + zp));
+	emit8(0x41); emit8(0x88); emit8(0x45); emit8(0x00);
+}
+
+// mov al, [rbx+offset]
+static void emitLoadReg(uint8_t offset) {
+	emit8(0x8A); emit8(0x43); emit8(offset);
+}
+
+// mov [rbx+offset], al
+static void emitStoreReg(uint8_t offset) {
+	emit8(0x88); emit8(0x43); emit8(offset);
+}
+
+// N and Z both come from al, same as setNZ()
+static void emitSetNZ(void) {
+	emitStoreReg(offsetof(cpu_t, nResult));
+	emitStoreReg(offsetof(cpu_t, zResult));
+}
+
+// the instruction without calling its handler, pc, the data bus and cycles have already been done
+// returns 0 if it has to be a call instead
+static uint8_t jitEmitInline(uint8_t opcode, cpuDecoded_t* op, uint16_t pc) {
+	const jitInline_t* in = &jitInlines[opcode];
+	uint8_t imm = jitModes[opcode] == MODE_IMM;
+	// immediate and relative operands aren't fetched until the instruction runs, so they aren't in op
+	// the page is there since cpuPeekInstruction() read the opcode from it
+	uint8_t operand = op->operand;
+	if(imm || jitModes[opcode] == MODE_REL) {
+		operand = ram->readPages[pc >> 8][(pc & 0xFF) + 1];
+		if(in->kind != JIT_CALL && in->kind != JIT_NOP) {
+			// reading it puts it on the data bus, mov byte [r13], operand
+			emit8(0x41); emit8(0xC6); emit8(0x45); emit8(0x00); emit8(operand);
+		}
+	}
+	switch(in->kind) {
+		case JIT_NOP:
+			return 1;
+		case JIT_LOAD:
+			if(imm) {
+				// mov al, imm8
+				emit8(0xB0); emit8(operand);
+			} else {
+				emitReadZP(0, operand);
+			}
+			emitStoreReg(in->dst);
+			emitSetNZ();
+			return 1;
+		case JIT_STORE:
+			emitLoadReg(in->src);
+			emitWriteZP(operand);
+			return 1;
+		case JIT_TRANSFER:
+		case JIT_MOVE:
+			emitLoadReg(in->src);
+			emitStoreReg(in->dst);
+			if(in->kind == JIT_TRANSFER) {
+				emitSetNZ();
+			}
+			return 1;
+		case JIT_INCREMENT:
+		case JIT_DECREMENT:
+			// inc/dec byte [rbx+dst]
+			emit8(0xFE); emit8(in->kind == JIT_INCREMENT ? 0x43 : 0x4B); emit8(in->dst);
+			emitLoadReg(in->dst);
+			emitSetNZ();
+			return 1;
+		case JIT_SET_FLAG:
+			// mov byte [rbx+dst], value
+			emit8(0xC6); emit8(0x43); emit8(in->dst); emit8(in->value);
+			return 1;
+		case JIT_COMPARE:
+			if(!imm) {
+				emitReadZP(1, operand);
+			}
+			emitLoadReg(in->src);
+			if(imm) {
+				// sub al, imm8
+				emit8(0x2C); emit8(operand);
+			} else {
+				// sub al, cl
+				emit8(0x28); emit8(0xC8);
+			}
+			// carry is set when there wasn't a borrow, setae byte [rbx+carry]
+			emit8(0x0F); emit8(0x93); emit8(0x43); emit8(offsetof(cpu_t, carry));
+			emitSetNZ();
+			return 1;
+		case JIT_LOGIC:
+			if(!imm) {
+				emitReadZP(1, operand);
+			}
+			emitLoadReg(in->src);
+			if(imm) {
+				// and/or/xor al, imm8
+				emit8(in->value); emit8(operand);
+			} else {
+				// and/or/xor al, cl
+				emit8(in->value - 4); emit8(0xC8);
+			}
+			emitStoreReg(in->dst);
+			emitSetNZ();
+			return 1;
+		case JIT_BRANCH: {
+			// same as branch(), the target and whether it crosses a page are known already
+			uint16_t next = pc + op->length;
+			uint16_t target = next + (int8_t)operand;
+			uint8_t extra = 1 + ((target >> 8) != (next >> 8));
+			// test byte [rbx+src], bits; jz/jnz over the taken path
+			emit8(0xF6); emit8(0x43); emit8(in->src); emit8(in->value);
+			emit8(in->takenIfSet ? 0x74 : 0x75); emit8(11);
+			// mov word [rbx+pc], target; add qword [rbx+cycles], extra
+			emit8(0x66); emit8(0xC7); emit8(0x43); emit8(offsetof(cpu_t, pc)); emit16(target);
+			emit8(0x48); emit8(0x83); emit8(0x43); emit8(offsetof(cpu_t, cycles)); emit8(extra);
+			return 1;
+		}
+		case JIT_JUMP:
+			// mov word [rbx+pc], operand
+			emit8(0x66); emit8(0xC7); emit8(0x43); emit8(offsetof(cpu_t, pc)); emit16(op->operand);
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+#define JIT_JA 0x87
+#define JIT_JE 0x84
+#define JIT_JMP 0xE9
+
+static uint64_t jitAddress(const void* p) {
+	return (uint64_t)(uintptr_t)p;
+}
+
+static void jitFlush(void) {
+	memset(jit->blocks, 0, sizeof(jit->blocks));
+	jit->codeUsed = 0;
+}
+
+// the code memory is never writable and executable at the same time
+// the pages a block could go in are made writable while it's translated and executable once it's done
+// nothing runs translated code while that happens since each console translates and runs its own on one thread
+static uint8_t jitProtect(uint8_t* from, int prot) {
+	uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)from & ~(pageSize - 1);
+	uintptr_t end = ((uintptr_t)from + JIT_MAX_BLOCK + pageSize - 1) & ~(pageSize - 1);
+	if(end > (uintptr_t)jit->code + JIT_CODE_SIZE) {
+		end = (uintptr_t)jit->code + JIT_CODE_SIZE;
+	}
+	return mprotect((void*)start, end - start, prot) == 0;
+}
+
+static void jitInit(void) {
+	void* code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(code == MAP_FAILED) {
+		printf("couldn't map memory for the jit, only using the interpreter\n");
+		jit->failed = 1;
+		return;
+	}
+	jit->code = code;
+	// kernels and selinux policies that don't allow executable memory refuse this, so find out before translating anything
+	if(!jitProtect(jit->code, PROT_READ | PROT_EXEC)) {
+		printf("couldn't make memory executable for the jit, only using the interpreter\n");
+		munmap(code, JIT_CODE_SIZE);
+		jit->code = NULL;
+		jit->failed = 1;
+		return;
+	}
+	jitFlush();
+}
+
+void jitUninit(void) {
+	if(jit->code) {
+		munmap(jit->code, JIT_CODE_SIZE);
+		jit->code = NULL;
+	}
+}
+
+// addresses known when translating get checked here instead of at runtime
+// reads from a page only change between direct and not when ram gets protected, which only affects writes
+static uint8_t jitCanTranslate(uint8_t opcode, cpuDecoded_t* op) {
+	uint8_t flags = jitFlags[opcode];
+	uint16_t operand = op->operand;
+	if(flags & JIT_INTERPRET) {
+		return 0;
+	}
+	switch(jitModes[opcode]) {
+		case MODE_ABS:
+			if(flags & JIT_JMP_IND) {
+				// same page wrapping as opJMP_IND
+				if(((operand + 1) & 0xFF) == 0xFF) {
+					operand -= 0x100;
+				}
+				return ram->readPages[operand >> 8] != NULL;
+			}
+			if(flags & JIT_WRITES) {
+				return ram->writePages[operand >> 8] != NULL;
+			}
+			if(flags & JIT_READS) {
+				return ram->readPages[operand >> 8] != NULL;
+			}
+			return 1;
+		case MODE_ABX:
+		case MODE_ABY:
+		case MODE_ABYD:
+			// the dummy read on a page cross is in the unindexed page
+			return ram->readPages[operand >> 8] != NULL;
+		default:
+			return 1;
+	}
+}
+
+static jitBlock_t* jitSlot(cpuDecoded_t* start, uint16_t pc) {
+	return &jit->blocks[((uintptr_t)start / sizeof(cpuDecoded_t) ^ pc) & (JIT_BLOCKS - 1)];
+}
+
+// returns 0 if there aren't enough instructions it can translate at pc
+static uint8_t jitTranslate(cpuDecoded_t* start, uint16_t startPC) {
+	// blocks write to zero page and the stack without checking if they're protected
+	if(startPC < 0x200) {
+		return 0;
+	}
+	if(jit->codeUsed + JIT_MAX_BLOCK > JIT_CODE_SIZE) {
+		jitFlush();
+	}
+	jit->out = jit->code + jit->codeUsed;
+	uint8_t* base = jit->out;
+	if(!jitProtect(base, PROT_READ | PROT_WRITE)) {
+		return 0;
+	}
+	uint8_t cyclesOffset = offsetof(cpu_t, cycles);
+	uint8_t pcOffset = offsetof(cpu_t, pc);
+
+	// pop r13; pop r12; pop rbx; ret
+	uint8_t* epilogue = jit->out;
+	emit8(0x41); emit8(0x5D);
+	emit8(0x41); emit8(0x5C);
+	emit8(0x5B);
+	emit8(0xC3);
+
+	// push rbx; push r12; push r13; mov rbx, cpu; mov r12, budget; mov r13, &ram.dataBus
+	uint8_t* entry = jit->out;
+	emit8(0x53);
+	emit8(0x41); emit8(0x54);
+	emit8(0x41); emit8(0x55);
+	emit8(0x48); emit8(0xBB); emit64(jitAddress(cpu));
+	emit8(0x49); emit8(0x89); emit8(0xFC);
+	emit8(0x49); emit8(0xBD); emit64(jitAddress(&ram->dataBus));
+
+	uint8_t* top = jit->out;
+	uint16_t pc = startPC;
+	uint16_t count = 0;
+	uint8_t ended = 0;
+	while((pc >> 8) == (startPC >> 8)) {
+		cpuDecoded_t op;
+		int16_t opcode = cpuPeekInstruction(pc, &op);
+		if(opcode < 0 || !jitCanTranslate(opcode, &op)) {
+			break;
+		}
+		uint8_t flags = jitFlags[opcode];
+		uint8_t mode = jitModes[opcode];
+
+		// cmp [rbx+cycles], r12; ja epilogue
+		// an nmi raised during anything but the last instruction's cycles would've been taken sooner by cpuStep()
+		emit8(0x4C); emit8(0x39); emit8(0x63); emit8(cyclesOffset);
+		emitJump(JIT_JA, epilogue);
+
+		if(flags & (JIT_READS | JIT_WRITES)) {
+			uint8_t (*guard)(uint16_t, uint8_t) = NULL;
+			switch(mode) {
+				case MODE_ABX: guard = jitGuardABX; break;
+				case MODE_ABY:
+				case MODE_ABYD: guard = jitGuardABY; break;
+				case MODE_IZX: guard = jitGuardIZX; break;
+				case MODE_IZY: guard = jitGuardIZY; break;
+				case MODE_ABS:
+					if(flags & JIT_WRITES) {
+						// mov rax, &ram.writePages[page]; cmp qword [rax], 0; je epilogue
+						emit8(0x48); emit8(0xB8); emit64(jitAddress(&ram->writePages[op.operand >> 8]));
+						emit8(0x48); emit8(0x83); emit8(0x38); emit8(0x00);
+						emitJump(JIT_JE, epilogue);
+					}
+					break;
+			}
+			if(guard) {
+				// mov edi, operand; mov esi, write; call guard; test al, al; je epilogue
+				uint64_t fn;
+				memcpy(&fn, &guard, sizeof(fn));
+				emit8(0xBF); emit32(op.operand);
+				emit8(0xBE); emit32((flags & JIT_WRITES) != 0);
+				emitCall(fn);
+				emit8(0x84); emit8(0xC0);
+				emitJump(JIT_JE, epilogue);
+			}
+		}
+
+		// mov word [rbx+pc], next pc; mov byte [r13], last byte; add qword [rbx+cycles], cycles
+		emit8(0x66); emit8(0xC7); emit8(0x43); emit8(pcOffset); emit16(pc + op.length);
+		emit8(0x41); emit8(0xC6); emit8(0x45); emit8(0x00); emit8(op.lastByte);
+		emit8(0x48); emit8(0x83); emit8(0x43); emit8(cyclesOffset); emit8(op.cycles);
+		#ifdef JIT_VERIFY
+			// mov rax, &jitInstructions; inc qword [rax]
+			emit8(0x48); emit8(0xB8); emit64(jitAddress(&jit->instructions));
+			emit8(0x48); emit8(0xFF); emit8(0x00);
+		#endif
+
+		if(!jitEmitInline(opcode, &op, pc)) {
+			// mov edi, operand; call handler
+			uint64_t handler;
+			memcpy(&handler, &op.handler, sizeof(handler));
+			emit8(0xBF); emit32(op.operand);
+			emitCall(handler);
+			if(op.pageCycles) {
+				// test al, al; jz +5; add qword [rbx+cycles], page cycles
+				emit8(0x84); emit8(0xC0);
+				emit8(0x74); emit8(0x05);
+				emit8(0x48); emit8(0x83); emit8(0x43); emit8(cyclesOffset); emit8(op.pageCycles);
+			}
+		}
+
+		++count;
+		pc += op.length;
+		if(flags & JIT_ENDS_BLOCK) {
+			ended = 1;
+			break;
+		}
+	}
+
+	// short blocks cost more to get in and out of than they save
+	if(count < JIT_MIN_INSTRUCTIONS) {
+		jitProtect(base, PROT_READ | PROT_EXEC);
+		return 0;
+	}
+	if(ended) {
+		// cmp word [rbx+pc], block pc; je top
+		emit8(0x66); emit8(0x81); emit8(0x7B); emit8(pcOffset); emit16(startPC);
+		emitJump(JIT_JE, top);
+	}
+	emitJump(JIT_JMP, epilogue);
+	if(!jitProtect(base, PROT_READ | PROT_EXEC)) {
+		return 0;
+	}
+
+	jit->codeUsed = jit->out - jit->code;
+	// whatever was in the slot before just gets translated again if it's still hot
+	jitBlock_t* block = jitSlot(start, startPC);
+	block->start = start;
+	block->pc = startPC;
+	memcpy(&block->code, &entry, sizeof(block->code));
+	// writes to ram the block came from need to throw it out
+	ramProtectCode(startPC);
+	return 1;
+}
+
+// the translated block starting at pc, NULL if it isn't hot yet or has to go through cpuStep()
+static jitBlock_t* jitLookup(uint16_t pc) {
+	cpuDecoded_t* code = ram->codePages[pc >> 8];
+	if(!code) {
+		return NULL;
+	}
+	cpuDecoded_t* start = code + (pc & 0xFF);
+	// cpuStep() hasn't been here yet
+	if(!start->handler) {
+		return NULL;
+	}
+	if(start->jitState < JIT_HOT_COUNT) {
+		++start->jitState;
+		if(start->jitState < JIT_HOT_COUNT) {
+			return NULL;
+		}
+		start->jitState = jitTranslate(start, pc) ? JIT_TRANSLATED : JIT_UNTRANSLATABLE;
+	}
+	if(start->jitState != JIT_TRANSLATED) {
+		return NULL;
+	}
+	jitBlock_t* block = jitSlot(start, pc);
+	if(block->start != start || block->pc != pc) {
+		// flushed or replaced by another block
+		start->jitState = 0;
+		return NULL;
+	}
+	return block;
+}
+
+void jitInvalidate(cpuDecoded_t* code, uint32_t size) {
+	for(uint32_t i = 0; i < JIT_BLOCKS; ++i) {
+		if(jit->blocks[i].start >= code && jit->blocks[i].start < code + size) {
+			memset(&jit->blocks[i], 0, sizeof(jitBlock_t));
+		}
+	}
+}
+
+#ifdef JIT_VERIFY
+__thread uint8_t jitRAMBefore[0x800];
+__thread uint8_t jitPrgRAMBefore[0x2000];
+__thread uint8_t jitRAMAfter[0x800];
+__thread uint8_t jitPrgRAMAfter[0x2000];
+
+// runs the block, then puts everything back and runs the same instructions through cpuStep() to compare
+static void jitVerify(jitBlock_t* block, uint64_t budget) {
+	cpu_t before = *cpu;
+	uint8_t busBefore = ram->dataBus;
+	memcpy(jitRAMBefore, ram->cpuRAM, sizeof(jitRAMBefore));
+	memcpy(jitPrgRAMBefore, ram->prgRAM, sizeof(jitPrgRAMBefore));
+
+	jit->instructions = 0;
+	block->code(budget);
+
+	cpu_t after = *cpu;
+	uint8_t afterP = cpuGetP();
+	uint8_t busAfter = ram->dataBus;
+	memcpy(jitRAMAfter, ram->cpuRAM, sizeof(jitRAMAfter));
+	memcpy(jitPrgRAMAfter, ram->prgRAM, sizeof(jitPrgRAMAfter));
+
+	*cpu = before;
+	ram->dataBus = busBefore;
+	memcpy(ram->cpuRAM, jitRAMBefore, sizeof(jitRAMBefore));
+	memcpy(ram->prgRAM, jitPrgRAMBefore, sizeof(jitPrgRAMBefore));
+	for(uint64_t i = 0; i < jit->instructions; ++i) {
+		cpuStep();
+	}
+
+	if(cpu->a != after.a || cpu->x != after.x || cpu->y != after.y || cpu->s != after.s || cpu->pc != after.pc || cpuGetP() != afterP || cpu->cycles != after.cycles || ram->dataBus != busAfter || memcmp(ram->cpuRAM, jitRAMAfter, sizeof(jitRAMAfter)) != 0 || memcmp(ram->prgRAM, jitPrgRAMAfter, sizeof(jitPrgRAMAfter)) != 0) {
+		printf("jit block at %04X doesn't match the interpreter after %lu instructions\n", block->pc, (unsigned long)jit->instructions);
+		printf("jit:    a: %02X x: %02X y: %02X s: %02X p: %02X pc: %04X cycles: %lu bus: %02X\n", after.a, after.x, after.y, after.s, afterP, after.pc, (unsigned long)after.cycles, busAfter);
+		printf("interp: a: %02X x: %02X y: %02X s: %02X p: %02X pc: %04X cycles: %lu bus: %02X\n", cpu->a, cpu->x, cpu->y, cpu->s, cpuGetP(), cpu->pc, (unsigned long)cpu->cycles, ram->dataBus);
+		exit(1);
+	}
+}
+#endif
+
+uint8_t jitRunBlocks(void) {
+	if(!jit->code) {
+		if(jit->failed) {
+			return 0;
+		}
+		jitInit();
+		if(!jit->code) {
+			return 0;
+		}
+	}
+	jitBlock_t* block = jitLookup(cpu->pc);
+	if(!block) {
+		return 0;
+	}
+	// the dmc's sample reads change the data bus in between instructions
+	// zero page and the stack get written without any checks, so they can't be protected code
+	if(apuDMCActive() || !ram->writePages[0] || !ram->writePages[1]) {
+		return 0;
+	}
+	// interrupts can only start showing up after the next event
+	uint64_t budget = scheduler->next > scheduler->cpuTime ? scheduler->next - scheduler->cpuTime : 0;
+
+	uint8_t ran = 0;
+	while(block && cpu->cycles <= budget) {
+		uint64_t cycles = cpu->cycles;
+		#ifdef JIT_VERIFY
+			jitVerify(block, budget);
+		#else
+			block->code(budget);
+		#endif
+		// the first instruction's check failed, it has to go through cpuStep()
+		if(cpu->cycles == cycles) {
+			break;
+		}
+		ran = 1;
+		block = jitLookup(cpu->pc);
+	}
+	if(ran) {
+		cpu->irq = 1;
+	}
+	return ran;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "cpu.h"
+#include "ram.h"
+
+// optional x86-64 recompiler for hot blocks of code, built with -DJIT
+// build with -DJIT_VERIFY as well to check every block it runs against cpuStep()
+
+// cpuDecoded_t's jitState counts how many times a block has been reached up to JIT_HOT_COUNT, then it gets translated
+#define JIT_HOT_COUNT 16
+#define JIT_TRANSLATED 0xFE
+#define JIT_UNTRANSLATABLE 0xFF
+
+#ifdef JIT
+
+#define JIT_BLOCKS 0x4000
+
+typedef struct {
+	// decoded instruction the block starts at, along with pc this is which prg bank and address it came from
+	cpuDecoded_t* start;
+	uint16_t pc;
+	void (*code)(uint64_t budget);
+} jitBlock_t;
+
+// translated code has the addresses of its console's cpu and ram built into it, so every console gets its own
+typedef struct {
+	jitBlock_t blocks[JIT_BLOCKS];
+	uint8_t* code;
+	size_t codeUsed;
+	uint8_t failed;
+	uint8_t* out;
+	#ifdef JIT_VERIFY
+		uint64_t instructions;
+	#endif
+} jit_t;
+
+extern __thread jit_t* jit;
+
+// what each opcode does as far as translating it goes, the same for every console
+void jitInitFlags(void);
+
+#endif
+
+uint8_t jitRunBlocks(void);
+
+// runs translated blocks starting at cpu.pc for as long as they can't be told apart from cpuStep()
+// returns 0 if nothing ran and cpuStep() should be used instead
+// the cheap checks are done here so code the jit can't help with doesn't have to pay for a call
+static inline uint8_t jitRun(void) {
+	cpuDecoded_t* code = ram->codePages[cpu->pc >> 8];
+	// interrupts get polled after every instruction in cpuStep(), blocks only run while they can't be taken
+	if(!code || code[cpu->pc & 0xFF].jitState == JIT_UNTRANSLATABLE || !(cpu->p & I_FLAG) || cpu->nmi == 0) {
+		return 0;
+	}
+	return jitRunBlocks();
+}
+
+// throws out translations made from the decoded instructions in code
+void jitInvalidate(cpuDecoded_t* code, uint32_t size);
+
+void jitUninit(void);
+
+#endif
@@ -1,71 +1,128 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "files.h"
-#include "ram.h"
-#include "rom.h"
-#include "cpu.h"
-#include "ppu.h"
-#include "apu.h"
-#include "input.h"
+#include "nes.h"
 #include "nsf.h"
-#include "dma.h"
+#include "frontend.h"
+#include "headless.h"
+#include "wide.h"
+#include "bench.h"
 
-int nesMain(void) {
-	while(1) {
-		if(!dmaActive) {
-			cpuStep();
-		} else {
-			dmaStep();
-		}
-		for(uint8_t i = 0; i < cpu.cycles; ++i) {
-			dmaCycle = !dmaCycle;
-			cycleCounter();
-			apuStep();
-			for(uint8_t j = 0; j < 3; ++j) {
-				if(ppu.currentPixel == 0) {
-					if(handleInput() != 0) { return 1; }
-				}
-				ppuStep();
-			}
-		}
-		cpu.cycles = 0;
-	};
+#ifndef HEADLESS
+// runs on its own thread, the main thread is left for the front end
+int emulate(void* data) {
+	nesBind(data);
+	if(rom->isNSF) {
+		nsfInit(0);
+		nsfMain();
+	} else {
+		cpuInit();
+		schedulerInit();
+		nesMain();
+	}
 	return 0;
 }
-
+#endif
 
 int main(int argc, char** argv) {
 	if(argc < 2) {
-		printf("usage: %s romPath\n", argv[0]);
+		printf("usage: %s romPath [--indexed] [--frameskip n] [--headless frames [--input path] [--dump-frame path] [--dump-audio path] [--dump-ram path]]\n", argv[0]);
 		return 1;
 	}
 
-	if(loadROM(argv[1]) != 0) {
+	#ifdef WIDE
+		// romPath --wide-bench lanes frames, runs the rom on the wide core and on a thread per console and compares them
+		if(argc == 5 && strcmp(argv[2], "--wide-bench") == 0) {
+			return wideBenchmark(argv[1], strtoul(argv[3], NULL, 10), strtoul(argv[4], NULL, 10));
+		}
+	#endif
+
+	#ifdef BENCHMARK
+		// romPath --cpu-bench instructions, runs just the cpu on the rom and prints how many instructions it gets through a second
+		if(argc == 4 && strcmp(argv[2], "--cpu-bench") == 0) {
+			return cpuBenchmark(argv[1], strtoull(argv[3], NULL, 10));
+		}
+	#endif
+
+	uint8_t headless = 0;
+	uint32_t frames = 0;
+	const char* inputPath = NULL;
+	const char* framePath = NULL;
+	const char* audioPath = NULL;
+	const char* ramPath = NULL;
+
+	nes_t* nes = nesCreate();
+	if(nes == NULL) {
+		printf("could not allocate the console\n");
 		return 1;
 	}
 
-	initInput();
-
-	initAPU();
+	for(int i = 2; i < argc; ++i) {
+		if(strcmp(argv[i], "--indexed") == 0) {
+			// draw frames as nes colors and only convert them when they're shown
+			ppu->indexedOutput = 1;
+		} else if(strcmp(argv[i], "--frameskip") == 0 && i + 1 < argc) {
+			// only draw and show every nth frame, for fast forwarding
+			int n = atoi(argv[++i]);
+			ppu->frameSkip = (n < 1 ? 1 : (n > 255 ? 255 : n));
+		} else if(strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+			// run that many frames without a window or sound and write out whatever dumps were asked for
+			headless = 1;
+			frames = strtoul(argv[++i], NULL, 10);
+		} else if(strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+			inputPath = argv[++i];
+		} else if(strcmp(argv[i], "--dump-frame") == 0 && i + 1 < argc) {
+			framePath = argv[++i];
+		} else if(strcmp(argv[i], "--dump-audio") == 0 && i + 1 < argc) {
+			audioPath = argv[++i];
+		} else if(strcmp(argv[i], "--dump-ram") == 0 && i + 1 < argc) {
+			ramPath = argv[++i];
+		} else {
+			printf("unknown option %s\n", argv[i]);
+			nesDestroy(nes);
+			return 1;
+		}
+	}
 
-	if(initRenderer() != 0) {
+	if(loadROM(argv[1]) != 0) {
+		nesDestroy(nes);
 		return 1;
 	}
 
-	if(rom.isNSF) {
-		nsfInit(0);
-		nsfMain();
-	} else {
-		cpuInit();
-		nesMain();
+	ramInit();
+
+	if(headless) {
+		uint8_t ret = headlessRun(frames, inputPath, framePath, audioPath, ramPath);
+		nesDestroy(nes);
+		return ret;
 	}
 
-	free(rom.prgROM);
-	free(rom.chrROM);
+	#ifdef HEADLESS
+		printf("this build can only run with --headless\n");
+		nesDestroy(nes);
+		return 1;
+	#else
+		initInput();
 
-	uninitRenderer();
+		initAPU();
 
-	return 0;
+		if(frontendInit() != 0) {
+			apuUninit();
+			nesDestroy(nes);
+			return 1;
+		}
+
+		frontendRun(emulate, nes);
+
+		// the audio thread reads from the console until the stream's gone
+		apuUninit();
+		frontendUninit();
+
+		nesDestroy(nes);
+
+		return 0;
+	#endif
 }
@@ -0,0 +1,119 @@
+// for posix_memalign() with -std=c99
+#define _POSIX_C_SOURCE 200112L
+#include "nes.h"
+#include "wide.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void noFrameDone(void) { return; }
+
+nes_t* nesCreate(void) {
+	// tables that are the same for every console
+	static uint8_t initialized = 0;
+	if(!initialized) {
+		initRenderer();
+		apuInitTables();
+		#ifdef JIT
+			jitInitFlags();
+		#endif
+		#ifdef WIDE
+			wideInit();
+		#endif
+		initialized = 1;
+	}
+
+	// calloc() only lines things up to 16 bytes, the audio ring's positions need their own cache lines
+	void* memory;
+	if(posix_memalign(&memory, CACHE_LINE, sizeof(nes_t)) != 0) {
+		return NULL;
+	}
+	nes_t* nes = memory;
+	memset(nes, 0, sizeof(nes_t));
+	nesBind(nes);
+
+	// zResult starts non zero so Z is clear like the rest of p
+	nes->cpu.zResult = 1;
+	nes->idle.length = -1;
+	nes->ppu.frame = &nes->frame;
+	nes->ppu.frameDone = noFrameDone;
+	nes->input.poll = inputNoPoll;
+	ppuInit();
+	apuInitState();
+
+	return nes;
+}
+
+void nesDestroy(nes_t* nes) {
+	nesBind(nes);
+	free(rom->prgROM);
+	free(rom->chrROM);
+	tilesUninit();
+	ramUninit();
+	#ifdef JIT
+		jitUninit();
+	#endif
+	free(nes);
+	nesBind(NULL);
+}
+
+void nesBind(nes_t* nes) {
+	if(nes == NULL) {
+		cpu = NULL;
+		ram = NULL;
+		ppu = NULL;
+		apu = NULL;
+		rom = NULL;
+		input = NULL;
+		dma = NULL;
+		idle = NULL;
+		scheduler = NULL;
+		tiles = NULL;
+		#ifdef JIT
+			jit = NULL;
+		#endif
+		return;
+	}
+	cpu = &nes->cpu;
+	ram = &nes->ram;
+	ppu = &nes->ppu;
+	apu = &nes->apu;
+	rom = &nes->rom;
+	input = &nes->input;
+	dma = &nes->dma;
+	idle = &nes->idle;
+	scheduler = &nes->scheduler;
+	tiles = &nes->tiles;
+	#ifdef JIT
+		jit = &nes->jit;
+	#endif
+}
+
+int nesMain(void) {
+	while(1) {
+		// oam dma runs one cycle at a time and needs dma.cycle to be up to date
+		if(scheduler->cpuTime > scheduler->next || dma->active) {
+			schedulerSync();
+			if(scheduler->quit) { return 1; }
+		}
+		if(!dma->active) {
+			uint16_t pc = cpu->pc;
+			if(scheduler->irqHeld) {
+				cpu->irq = 0;
+			}
+			#ifdef JIT
+				if(!jitRun()) {
+					cpuStep();
+				}
+			#else
+				cpuStep();
+			#endif
+			idleTrack(pc);
+		} else {
+			dmaStep();
+		}
+		scheduler->cpuTime += cpu->cycles;
+		cpu->cycles = 0;
+	};
+	return 0;
+}
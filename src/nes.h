@@ -0,0 +1,52 @@
+#ifndef NES_H
+#define NES_H
+
+#include "cpu.h"
+#include "ram.h"
+#include "ppu.h"
+#include "apu.h"
+#include "rom.h"
+#include "input.h"
+#include "dma.h"
+#include "idle.h"
+#include "scheduler.h"
+#include "tiles.h"
+#include "jit.h"
+
+// everything one console needs, so a single process can run as many of them as it wants
+// each module works on the console its pointer (cpu, ppu, rom, ...) is bound to, those are per thread,
+// so different threads can run different consoles at the same time without anything getting passed around
+// a console can move between threads as long as only one thread is running it at a time
+typedef struct nes_t {
+	cpu_t cpu;
+	ram_t ram;
+	ppu_t ppu;
+	apu_t apu;
+	rom_t rom;
+	input_t input;
+	dma_t dma;
+	idle_t idle;
+	scheduler_t scheduler;
+	tiles_t tiles;
+	#ifdef JIT
+		jit_t jit;
+	#endif
+	// where frames get drawn unless something else gives the ppu somewhere to draw them
+	frame_t frame;
+} nes_t;
+
+// returns a powered off console bound to the calling thread, NULL if it couldn't be allocated
+// consoles have to be created from one thread at a time
+nes_t* nesCreate(void);
+// frees the console along with its rom and leaves the calling thread unbound
+void nesDestroy(nes_t* nes);
+// points every module at nes for the calling thread, NULL unbinds it
+void nesBind(nes_t* nes);
+// the default ppu.frameDone
+void noFrameDone(void);
+
+// runs the bound console until input.poll or something else sets scheduler.quit, returns 1 when it stops
+// clearing scheduler.quit and calling it again keeps going from where it stopped
+int nesMain(void);
+
+#endif // NES_H
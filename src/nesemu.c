@@ -0,0 +1,141 @@
+#include "nesemu.h"
+
+#include <string.h>
+
+#include "nes.h"
+#include "files.h"
+#include "pool.h"
+
+// every call binds the console it's given first since the thread calling it could have been running a different one
+
+void nesemuStopAtFrame(void) {
+	scheduler->quit = 1;
+}
+
+// ramInit() is where nesemuLoadROM() starts powering the console on, one whose rom didn't load has nothing mapped to run
+uint8_t nesemuPoweredOn(nesemu_t* nes) {
+	return nes->ram.codeRegionCount > 0;
+}
+
+uint32_t nesemuVersion(void) {
+	return NESEMU_API_VERSION;
+}
+
+nesemu_t* nesemuCreate(void) {
+	nes_t* nes = nesCreate();
+	nesBind(NULL);
+	return nes;
+}
+
+void nesemuDestroy(nesemu_t* nes) {
+	if(nes == NULL) { return; }
+	nesDestroy(nes);
+}
+
+int nesemuLoadROM(nesemu_t* nes, const uint8_t* data, size_t size) {
+	if(nes->rom.prgROM != NULL || nes->rom.chrROM != NULL) {
+		return 1;
+	}
+	nesBind(nes);
+	if(loadROMFromMemory(data, size) != 0) {
+		return 1;
+	}
+	// nsf files need the player in nsf.c, which needs the frontend
+	if(rom->isNSF) {
+		return 1;
+	}
+	ramInit();
+	cpuInit();
+	schedulerInit();
+	return 0;
+}
+
+void nesemuSetButtons(nesemu_t* nes, uint32_t port, uint8_t buttons) {
+	nes->input.controllers[port & 1].buttons = buttons;
+}
+
+void nesemuStepFrame(nesemu_t* nes) {
+	if(!nesemuPoweredOn(nes)) {
+		return;
+	}
+	nesBind(nes);
+	ppu->frameDone = nesemuStopAtFrame;
+	apu->sampleCount = 0;
+	scheduler->quit = 0;
+	nesMain();
+}
+
+uint64_t nesemuStepCycles(nesemu_t* nes, uint64_t cycles) {
+	if(!nesemuPoweredOn(nes) || cycles == 0) {
+		return 0;
+	}
+	nesBind(nes);
+	uint64_t start = scheduler->cpuTime;
+	ppu->frameDone = noFrameDone;
+	apu->sampleCount = 0;
+	scheduler->quit = 0;
+	schedulerStopAt(cycles > UINT64_MAX - start ? UINT64_MAX : start + cycles);
+	nesMain();
+	schedulerStopAt(UINT64_MAX);
+	return scheduler->cpuTime - start;
+}
+
+uint64_t nesemuCycles(nesemu_t* nes) {
+	return nes->scheduler.cpuTime;
+}
+
+const uint32_t* nesemuFrame(nesemu_t* nes) {
+	return nes->frame.pixels;
+}
+
+const float* nesemuAudio(nesemu_t* nes, uint32_t* count) {
+	if(count) {
+		*count = nes->apu.sampleCount;
+	}
+	return nes->apu.samples;
+}
+
+uint8_t* nesemuRAM(nesemu_t* nes) {
+	return nes->ram.cpuRAM;
+}
+
+nesemu_pool_t* nesemuPoolCreate(uint32_t threads) {
+	return poolCreate(threads);
+}
+
+void nesemuPoolDestroy(nesemu_pool_t* pool) {
+	poolDestroy(pool);
+}
+
+typedef struct {
+	nesemu_t* const* consoles;
+	const uint8_t* buttons;
+	uint32_t frames;
+	uint32_t* framesOut;
+	uint8_t* ramOut;
+} nesemuBatch_t;
+
+void nesemuBatchTask(void* data, uint32_t index) {
+	nesemuBatch_t* batch = data;
+	nesemu_t* nes = batch->consoles[index];
+	nesemuSetButtons(nes, 0, batch->buttons ? batch->buttons[index] : 0);
+	for(uint32_t i = 0; i < batch->frames; ++i) {
+		nesemuStepFrame(nes);
+	}
+	if(batch->framesOut) {
+		memcpy(batch->framesOut + (size_t)index*NESEMU_FRAME_WIDTH*NESEMU_FRAME_HEIGHT, nes->frame.pixels, sizeof(nes->frame.pixels));
+	}
+	if(batch->ramOut) {
+		memcpy(batch->ramOut + (size_t)index*NESEMU_RAM_SIZE, nes->ram.cpuRAM, sizeof(nes->ram.cpuRAM));
+	}
+}
+
+void nesemuStepBatch(nesemu_pool_t* pool, nesemu_t* const* consoles, const uint8_t* buttons, uint32_t count, uint32_t frames, uint32_t* framesOut, uint8_t* ramOut) {
+	nesemuBatch_t batch;
+	batch.consoles = consoles;
+	batch.buttons = buttons;
+	batch.frames = frames;
+	batch.framesOut = framesOut;
+	batch.ramOut = ramOut;
+	poolRun(pool, nesemuBatchTask, &batch, count);
+}
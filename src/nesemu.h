@@ -0,0 +1,91 @@
+#ifndef NESEMU_H
+#define NESEMU_H
+
+// libnesemu, build/libnesemu.so from LIB=1 ./build.sh
+// lets other programs run consoles without going through the frontend, everything is plain c types so it can be used over ffi too
+// a console can be used from any thread but only from one at a time, different consoles can run on different threads at once
+// nothing in here gets renamed or changes its arguments, new things only get added, NESEMU_API_VERSION goes up when they do
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+	#define NESEMU_API __attribute__((visibility("default")))
+#else
+	#define NESEMU_API
+#endif
+
+#define NESEMU_API_VERSION 2
+
+#define NESEMU_FRAME_WIDTH 256
+#define NESEMU_FRAME_HEIGHT 240
+#define NESEMU_RAM_SIZE 0x800
+#define NESEMU_SAMPLE_RATE 48000
+
+// https://www.nesdev.org/wiki/Standard_controller
+// bits for nesemuSetButtons()
+#define NESEMU_BUTTON_A 0x01
+#define NESEMU_BUTTON_B 0x02
+#define NESEMU_BUTTON_SELECT 0x04
+#define NESEMU_BUTTON_START 0x08
+#define NESEMU_BUTTON_UP 0x10
+#define NESEMU_BUTTON_DOWN 0x20
+#define NESEMU_BUTTON_LEFT 0x40
+#define NESEMU_BUTTON_RIGHT 0x80
+
+typedef struct nes_t nesemu_t;
+typedef struct pool_t nesemu_pool_t;
+
+// NESEMU_API_VERSION of the library that got loaded
+NESEMU_API uint32_t nesemuVersion(void);
+
+// returns a powered off console with no rom, NULL if it couldn't be allocated
+// consoles have to be created from one thread at a time
+NESEMU_API nesemu_t* nesemuCreate(void);
+NESEMU_API void nesemuDestroy(nesemu_t* nes);
+
+// takes an ines or nes 2.0 rom and powers the console on, data gets copied so it can be freed right after
+// returns 0 on success, a console only takes one rom and it has to be destroyed if this fails
+NESEMU_API int nesemuLoadROM(nesemu_t* nes, const uint8_t* data, size_t size);
+
+// buttons held on controller port (0 or 1) from now on, as NESEMU_BUTTON_ bits
+NESEMU_API void nesemuSetButtons(nesemu_t* nes, uint32_t port, uint8_t buttons);
+
+// the step functions don't do anything until a rom has been loaded
+// runs until the start of the next vblank, when the frame has just finished being drawn
+NESEMU_API void nesemuStepFrame(nesemu_t* nes);
+// runs at least cycles cpu cycles and returns how many it actually ran, it only goes over by the rest of an instruction or dma
+// it stops on the first instruction boundary at or after that, so 0 doesn't run anything
+NESEMU_API uint64_t nesemuStepCycles(nesemu_t* nes, uint64_t cycles);
+// cpu cycles since power on
+NESEMU_API uint64_t nesemuCycles(nesemu_t* nes);
+
+// these point into the console, they stay the same for as long as it's around and get written to by every step
+// NESEMU_FRAME_WIDTH*NESEMU_FRAME_HEIGHT pixels of the last frame drawn, as 0xRRGGBBAA
+NESEMU_API const uint32_t* nesemuFrame(nesemu_t* nes);
+// mono float samples at NESEMU_SAMPLE_RATE made by the last step, they come out about a frame's worth at a time
+NESEMU_API const float* nesemuAudio(nesemu_t* nes, uint32_t* count);
+// the NESEMU_RAM_SIZE bytes of work ram at $0000-$07FF, writes to it are seen by the console
+NESEMU_API uint8_t* nesemuRAM(nesemu_t* nes);
+
+// worker threads for nesemuStepBatch(), each one pinned to its own cpu out of the ones the process is allowed on
+// threads 0 starts one for every one of those cpus, returns NULL if they couldn't be started
+NESEMU_API nesemu_pool_t* nesemuPoolCreate(uint32_t threads);
+NESEMU_API void nesemuPoolDestroy(nesemu_pool_t* pool);
+// sets controller 1 of consoles[i] to buttons[i] (or nothing if buttons is NULL) and runs it frames frames, for every i below count
+// then copies its frame into framesOut + i*NESEMU_FRAME_WIDTH*NESEMU_FRAME_HEIGHT and its ram into ramOut + i*NESEMU_RAM_SIZE, either can be NULL
+// the consoles get spread over the pool's threads, but each one only ever gets run by one of them and only writes its own part
+// of the outputs, so everything comes out the same as stepping them one after the other no matter which thread ran what
+// a console can only be in consoles once, and only one thread can be running batches on a pool at a time
+// nesemuAudio() has the samples from each console's last frame afterwards
+NESEMU_API void nesemuStepBatch(nesemu_pool_t* pool, nesemu_t* const* consoles, const uint8_t* buttons, uint32_t count, uint32_t frames, uint32_t* framesOut, uint8_t* ramOut);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NESEMU_H
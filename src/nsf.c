@@ -1,5 +1,8 @@
 #include "nsf.h"
 
+// nsf files only play through the front end, the headless build leaves them out
+#ifndef HEADLESS
+
 #include <SDL3/SDL.h>
 
 #include "ram.h"
@@ -9,6 +12,7 @@
 #include "ppu.h"
 #include "apu.h"
 #include "debug.h"
+#include "frontend.h"
 
 void nsfInit(uint8_t song) {
 	// https://www.nesdev.org/wiki/NSF#Initializing_a_tune
@@ -21,17 +25,17 @@ void nsfInit(uint8_t song) {
 	for(uint16_t i = 0x4000; i < 0x4014; ++i) {
 		ramWriteByte(i, 0);
 	}
-	cpu.irq = 1;
-	cpu.nmi = 1;
+	cpu->irq = 1;
+	cpu->nmi = 1;
 	ramWriteByte(0x4015, 0);
 	ramWriteByte(0x4015, 0xF);
 	ramWriteByte(0x4017, 0x40);
-	cpu.a = song;
-	cpu.x = 0;
+	cpu->a = song;
+	cpu->x = 0;
 	push(0);
 	push(0);
-	cpu.pc = rom.nsfInitAddr;
-	while(cpu.pc != 1) { // rts puts it 1 byte ahead of the address pushed to the stack
+	cpu->pc = rom->nsfInitAddr;
+	while(cpu->pc != 1) { // rts puts it 1 byte ahead of the address pushed to the stack
 		cpuStep();
 	}
 }
@@ -39,20 +43,20 @@ void nsfInit(uint8_t song) {
 int nsfMain(void) {
 	push(0);
 	push(0);
-	cpu.pc = rom.nsfPlayAddr;
-	uint64_t rate = 1000000/rom.nsfSpeed;
+	cpu->pc = rom->nsfPlayAddr;
+	uint64_t rate = 1000000/rom->nsfSpeed;
 	uint64_t timerPeriod = 1789773/rate;
 	int64_t timer = timerPeriod;
 	//printf("%lu %lu\n", timerPeriod, rate);
-	cpu.cycles = 0;
+	cpu->cycles = 0;
 	while(1) {
-		while(cpu.pc != 1) {
+		while(cpu->pc != 1) {
 			cpuStep();
-			for(uint8_t i = 0; i < cpu.cycles; ++i) {
+			for(uint8_t i = 0; i < cpu->cycles; ++i) {
 				apuStep();
 			}
-			timer -= cpu.cycles;
-			cpu.cycles = 0;
+			timer -= cpu->cycles;
+			cpu->cycles = 0;
 		}
 		//printf("balls %i\n", timer);
 		if(timer > 0) {
@@ -63,10 +67,10 @@ int nsfMain(void) {
 		timer = timerPeriod;
 		push(0);
 		push(0);
-		cpu.pc = rom.nsfPlayAddr;
+		cpu->pc = rom->nsfPlayAddr;
 
-		if(handleInput() != 0) { return 1; }
-		drawDebugText(0, 0, "song: %s\nauthor: %s", rom.nsfSongName, rom.nsfSongAuthor);
+		if(input->poll() != 0) { return 1; }
+		drawDebugText(0, 0, "song: %s\nauthor: %s", rom->nsfSongName, rom->nsfSongAuthor);
 		render();
 
 		static uint64_t t1 = 0;
@@ -82,3 +86,5 @@ int nsfMain(void) {
 	}
 	return 0;
 }
+
+#endif
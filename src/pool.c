@@ -0,0 +1,175 @@
+// for sched_getaffinity() and pthread_attr_setaffinity_np()
+#define _GNU_SOURCE
+#include "pool.h"
+
+#include <stdlib.h>
+#include <sched.h>
+
+#define POOL_RANGE(next, end) (((uint64_t)(end) << 32) | (next))
+
+uint8_t poolTakeOwn(poolQueue_t* queue, uint32_t* index) {
+	uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+	while(1) {
+		uint32_t next = (uint32_t)range;
+		uint32_t end = range >> 32;
+		if(next >= end) {
+			return 0;
+		}
+		// a failed swap puts what's there now into range and it gets looked at again
+		if(__atomic_compare_exchange_n(&queue->range, &range, POOL_RANGE(next + 1, end), 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			*index = next;
+			return 1;
+		}
+	}
+}
+
+// only called once the worker's own queue is empty, nothing else puts anything in it so it can just be stored
+uint8_t poolSteal(pool_t* pool, uint32_t id, uint32_t* index) {
+	for(uint32_t i = 1; i < pool->workerCount; ++i) {
+		poolQueue_t* victim = &pool->queues[(id + i) % pool->workerCount];
+		uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+		while(1) {
+			uint32_t next = (uint32_t)range;
+			uint32_t end = range >> 32;
+			if(next >= end) {
+				break;
+			}
+			uint32_t mid = next + (end - next)/2;
+			if(__atomic_compare_exchange_n(&victim->range, &range, POOL_RANGE(next, mid), 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				// the first stolen one gets run now and the rest can get stolen back from here
+				__atomic_store_n(&pool->queues[id].range, POOL_RANGE(mid + 1, end), __ATOMIC_RELEASE);
+				*index = mid;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+void* poolWorkerMain(void* arg) {
+	poolWorker_t* worker = arg;
+	pool_t* pool = worker->pool;
+	uint32_t generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while(1) {
+		while(!pool->quit && pool->generation == generation) {
+			pthread_cond_wait(&pool->start, &pool->lock);
+		}
+		if(pool->quit) {
+			break;
+		}
+		generation = pool->generation;
+		poolTask_t task = pool->task;
+		void* data = pool->data;
+		pthread_mutex_unlock(&pool->lock);
+
+		uint32_t index;
+		while(poolTakeOwn(&pool->queues[worker->id], &index) || poolSteal(pool, worker->id, &index)) {
+			task(data, index);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->busy == 0) {
+			pthread_cond_signal(&pool->done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+pool_t* poolCreate(uint32_t workerCount) {
+	cpu_set_t allowed;
+	int32_t cpus[CPU_SETSIZE];
+	uint32_t cpuCount = 0;
+	if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+		for(int32_t i = 0; i < CPU_SETSIZE; ++i) {
+			if(CPU_ISSET(i, &allowed)) {
+				cpus[cpuCount++] = i;
+			}
+		}
+	}
+	if(workerCount == 0) {
+		workerCount = (cpuCount > 0 ? cpuCount : 1);
+	}
+	if(workerCount > POOL_MAX_WORKERS) {
+		workerCount = POOL_MAX_WORKERS;
+	}
+
+	pool_t* pool = calloc(1, sizeof(pool_t));
+	if(pool == NULL) {
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for(uint32_t i = 0; i < workerCount; ++i) {
+		poolWorker_t* worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->id = i;
+		worker->cpu = -1;
+
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		// more workers than cpus just wrap around, they'd end up sharing one either way
+		if(cpuCount > 0) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[i % cpuCount], &set);
+			if(pthread_attr_setaffinity_np(&attr, sizeof(set), &set) == 0) {
+				worker->cpu = cpus[i % cpuCount];
+			}
+		}
+		int error = pthread_create(&worker->thread, &attr, poolWorkerMain, worker);
+		pthread_attr_destroy(&attr);
+		if(error != 0) {
+			pool->workerCount = i;
+			poolDestroy(pool);
+			return NULL;
+		}
+		pool->workerCount = i + 1;
+	}
+
+	return pool;
+}
+
+void poolDestroy(pool_t* pool) {
+	if(pool == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for(uint32_t i = 0; i < pool->workerCount; ++i) {
+		pthread_join(pool->workers[i].thread, NULL);
+	}
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool);
+}
+
+void poolRun(pool_t* pool, poolTask_t task, void* data, uint32_t count) {
+	if(count == 0) {
+		return;
+	}
+	// contiguous shares keep neighbouring indices on one worker unless they get stolen
+	for(uint32_t i = 0; i < pool->workerCount; ++i) {
+		uint32_t next = (uint64_t)count * i / pool->workerCount;
+		uint32_t end = (uint64_t)count * (i + 1) / pool->workerCount;
+		__atomic_store_n(&pool->queues[i].range, POOL_RANGE(next, end), __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->data = data;
+	pool->busy = pool->workerCount;
+	++pool->generation;
+	pthread_cond_broadcast(&pool->start);
+	while(pool->busy > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
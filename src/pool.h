@@ -0,0 +1,61 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// https://en.wikipedia.org/wiki/Work_stealing
+// a fixed set of worker threads that run a task for every index in 0 to count-1 and wait until they're all done
+// each worker starts with an even share of the indices and takes them from the front one at a time,
+// once it runs out it takes the back half of whatever another worker has left so slow tasks don't hold everything up
+// every index gets run exactly once by one worker, so as long as tasks for different indices don't share anything
+// what they do doesn't depend on which worker ran them or in what order
+
+#define POOL_MAX_WORKERS 256
+#define POOL_CACHE_LINE 64
+
+typedef void (*poolTask_t)(void* data, uint32_t index);
+
+// the indices a worker has left, next in the low 32 bits and end in the high 32 bits
+// they're together so the owner and thieves can both change them with one compare and swap
+typedef struct {
+	uint64_t range;
+	uint8_t pad[POOL_CACHE_LINE - sizeof(uint64_t)];
+} poolQueue_t;
+
+typedef struct pool_t pool_t;
+
+typedef struct {
+	pool_t* pool;
+	uint32_t id;
+	// the cpu it's pinned to, -1 if it couldn't be
+	int32_t cpu;
+	pthread_t thread;
+} poolWorker_t;
+
+struct pool_t {
+	uint32_t workerCount;
+	poolWorker_t workers[POOL_MAX_WORKERS];
+	poolQueue_t queues[POOL_MAX_WORKERS];
+
+	// the current job, workers pick it up when generation changes
+	poolTask_t task;
+	void* data;
+	uint32_t generation;
+	// workers still going on the current job
+	uint32_t busy;
+	uint8_t quit;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+};
+
+// starts workerCount threads, pinned one per cpu the process is allowed on, 0 starts one for each of those cpus
+// returns NULL if the threads couldn't be started
+pool_t* poolCreate(uint32_t workerCount);
+void poolDestroy(pool_t* pool);
+// runs task(data, i) for every i below count on the workers and returns once they're all done
+// only one thread can be running jobs on a pool at a time
+void poolRun(pool_t* pool, poolTask_t task, void* data, uint32_t count);
+
+#endif // POOL_H
@@ -1,15 +1,23 @@
 #include "ppu.h"
 
-#include "SDL3/SDL.h"
-
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// the avx2 kernels get compiled in with gcc's target attribute and are only used if the cpu running this has it
+#if defined(__GNUC__) && defined(__x86_64__)
+	#define PPU_AVX2
+#endif
+#if defined(__SSE2__) || defined(PPU_AVX2)
+	#include <immintrin.h>
+#endif
 
 #include "rom.h"
 #include "ram.h"
 #include "cpu.h"
 #include "input.h"
 #include "apu.h"
+#include "tiles.h"
 
 #include "debug.h"
 
@@ -20,13 +28,7 @@
 #define COARSE_Y 0x3E0
 #define COARSE_X 0x1F
 
-ppu_t ppu;
-
-uint8_t fpsUncap = 0;
-
-SDL_Window* w;
-SDL_Surface* windowSurface;
-SDL_Surface* frameBuffer;
+__thread ppu_t* ppu;
 
 // generated with this: https://github.com/Gumball2415/palgen-persune
 // palgen_persune.py -o test -f ".txt HTML hex"
@@ -98,338 +100,761 @@ uint32_t paletteColors[] = {
 	0x000000FF,
 };
 
-uint8_t nametables[2][0x400];
-uint8_t paletteRAM[0x20];
+// paletteColors with every combination of the emphasis bits in ppu.mask applied, indexed by (ppu.mask >> 5)*64 + color
+uint32_t emphasisColors[8*64];
+
+// https://www.nesdev.org/wiki/NTSC_video#Color_Tint_Bits
+// each emphasis bit darkens the other two channels, columns $E and $F are black and stay that way
+void ppuInitEmphasis(void) {
+	for(uint16_t i = 0; i < 8*64; ++i) {
+		uint8_t emphasis = i / 64;
+		uint32_t color = paletteColors[i % 64];
+		if(((i % 64) & 0x0F) >= 0x0E) {
+			emphasisColors[i] = color;
+			continue;
+		}
+		float channels[3] = {(color >> 24) & 0xFF, (color >> 16) & 0xFF, (color >> 8) & 0xFF};
+		for(uint8_t bit = 0; bit < 3; ++bit) {
+			if(!(emphasis & (1 << bit))) { continue; }
+			for(uint8_t channel = 0; channel < 3; ++channel) {
+				if(channel != bit) {
+					channels[channel] *= 0.746f;
+				}
+			}
+		}
+		emphasisColors[i] = ((uint32_t)channels[0] << 24) | ((uint32_t)channels[1] << 16) | ((uint32_t)channels[2] << 8) | (color & 0xFF);
+	}
+}
 
-uint8_t ppuRAMRead(uint16_t addr) {
-	if(addr < 0x2000) {
-		chrReadByte(ppu.vramAddr);
-	} else if(addr >= 0x2000 && addr <= 0x2FFF) {
-		uint8_t tableIndex;
-		switch(ppu.mirror) {
+void ppuResolvePalette(uint8_t i) {
+	uint8_t color = ppu->paletteRAM[i];
+	if(ppu->mask & PPU_MASK_GRAY) {
+		color &= 0x30;
+	}
+	ppu->paletteRGBA[i] = emphasisColors[(ppu->mask >> 5)*64 + color];
+	ppu->paletteIndexed[i] = color;
+}
+
+// fills in frame's rgba pixels from its indexed ones
+void ppuIndexedToRGBA(frame_t* frame) {
+	for(uint16_t y = 0; y < FB_HEIGHT; ++y) {
+		const uint32_t* colors = &emphasisColors[frame->emphasis[y]*64];
+		for(uint16_t x = 0; x < FB_WIDTH; ++x) {
+			frame->pixels[y*FB_WIDTH + x] = colors[frame->indexed[y*FB_WIDTH + x]];
+		}
+	}
+}
+
+void ppuMaskWrite(uint8_t byte) {
+	uint8_t changed = ppu->mask ^ byte;
+	ppu->mask = byte;
+	if(changed & (PPU_MASK_GRAY | PPU_MASK_EMPH_RED | PPU_MASK_EMPH_GREEN | PPU_MASK_EMPH_BLUE)) {
+		for(uint8_t i = 0; i < 0x20; ++i) {
+			ppuResolvePalette(i);
+		}
+	}
+}
+
+// https://www.nesdev.org/wiki/MMC2#CHR_banking
+// reading the second bitplane of tile $FD or $FE flips a latch on mmc2, nothing else needs to tell the mapper about chr reads
+uint8_t ppuCHRRead(uint16_t addr) {
+	if(rom->chrLatch && ((addr & 0x0FF8) == 0x0FD8 || (addr & 0x0FF8) == 0x0FE8)) {
+		rom->chrLatchRead(addr);
+	}
+	return ppu->patternBanks[(addr >> 10) & 0xF][addr & 0x3FF];
+}
+
+void ppuSetMirroring(uint8_t mode) {
+	ppu->mirror = mode;
+	for(uint8_t i = 0; i < 4; ++i) {
+		switch(mode) {
 			case MIRROR_VERTICAL:
-				tableIndex = (addr >> 11) & 1;
+				ppu->nametableBanks[i] = ppu->nametables[i >> 1];
 				break;
 			case MIRROR_HORIZONTAL:
-				tableIndex = (addr >> 10) & 1;
+				ppu->nametableBanks[i] = ppu->nametables[i & 1];
 				break;
 			case MIRROR_SINGLE_SCREEN1:
-				tableIndex = 0;
+				ppu->nametableBanks[i] = ppu->nametables[0];
 				break;
 			case MIRROR_SINGLE_SCREEN2:
-				tableIndex = 1;
+				ppu->nametableBanks[i] = ppu->nametables[1];
 				break;
 			default:
-				printf("unimplemented mirroring mode %i\n", ppu.mirror);
+				printf("unimplemented mirroring mode %i\n", mode);
 				exit(1);
 				break;
 		}
-		return nametables[tableIndex][addr & 0x3FF];
+	}
+}
+
+uint8_t ppuRAMRead(uint16_t addr) {
+	if(addr < 0x2000) {
+		return ppuCHRRead(addr);
+	} else if(addr >= 0x2000 && addr <= 0x2FFF) {
+		return ppu->nametableBanks[(addr >> 10) & 3][addr & 0x3FF];
 	} else if(addr >= 0x3F00) {
-		return paletteRAM[addr & 0x1F] & 0x3F;
+		return ppu->paletteRAM[addr & 0x1F] & 0x3F;
 	}
 }
 
 void ppuRAMWrite(uint16_t addr, uint8_t byte) {
 	if(addr < 0x2000) {
-		chrWriteByte(ppu.vramAddr, byte);
+		rom->chrWriteByte(addr, byte);
 	} else if(addr >= 0x2000 && addr <= 0x2FFF) {
-		uint8_t tableIndex;
-		switch(ppu.mirror) {
-			case MIRROR_VERTICAL:
-				tableIndex = (addr >> 11) & 1;
-				break;
-			case MIRROR_HORIZONTAL:
-				tableIndex = (addr >> 10) & 1;
-				break;
-			case MIRROR_SINGLE_SCREEN1:
-				tableIndex = 0;
-				break;
-			case MIRROR_SINGLE_SCREEN2:
-				tableIndex = 1;
-				break;
-			default:
-				printf("unimplemented mirroring mode %i\n", ppu.mirror);
-				exit(1);
-				break;
-		}
-		nametables[tableIndex][addr & 0x3FF] = byte;
+		ppu->nametableBanks[(addr >> 10) & 3][addr & 0x3FF] = byte;
 	} else if(addr >= 0x3F00) {
 		byte &= 0x3F;
-		if(addr % 4 == 0) { paletteRAM[(addr & 0x1F)^0x10] = byte; }
-		paletteRAM[addr & 0x1F] = byte;
+		if(addr % 4 == 0) {
+			ppu->paletteRAM[(addr & 0x1F)^0x10] = byte;
+			ppuResolvePalette((addr & 0x1F)^0x10);
+		}
+		ppu->paletteRAM[addr & 0x1F] = byte;
+		ppuResolvePalette(addr & 0x1F);
 	}
 }
 
+// the window and everything else to do with showing frames is in frontend.c
+// this only sets up what every console shares, nesCreate() calls it before the first one
 uint8_t initRenderer(void) {
-	if(SDL_Init(SDL_INIT_VIDEO) == 0) {
-		printf("could not init SDL\n");
-		return 1;
+	ppuSelectKernels();
+	ppuInitEmphasis();
+
+	return 0;
+}
+
+void ppuInit(void) {
+	ppu->frameSkip = 1;
+	ppuSetMirroring(MIRROR_VERTICAL);
+	ppuRebuildOAMIndex();
+	for(uint8_t i = 0; i < 0x20; ++i) {
+		ppuResolvePalette(i);
 	}
+}
 
-	w = SDL_CreateWindow("nesEmu", SCREEN_WIDTH, SCREEN_HEIGHT, 0);
-	windowSurface = SDL_GetWindowSurface(w);
-	frameBuffer = SDL_CreateSurface(FB_WIDTH, FB_HEIGHT,SDL_PIXELFORMAT_RGBA8888);
+// the pixels of the pattern table row at addr, flipped horizontally if flip is set
+// mmc2's latches have to see the reads, everything else can use the tile cache
+uint8_t* ppuTileRow(uint16_t addr, uint8_t flip) {
+	if(rom->chrLatch) {
+		uint8_t* row = ppu->latchRow;
+		uint8_t bitplane1 = ppuCHRRead(addr);
+		uint8_t bitplane2 = ppuCHRRead(addr + 8);
+		for(uint8_t x = 0; x < 8; ++x) {
+			row[flip ? 7 - x : x] = ((bitplane1 >> (7-x)) & 1) | (((bitplane2 >> (7-x)) & 1) << 1);
+		}
+		return row;
+	}
+	return tilesGetRow(ppu->patternBanks[addr >> 10] - rom->chrROM + (addr & 0x3FF), flip);
+}
 
-	initDebugRenderer();
+// which palette ram entry a pixel of a background tile uses
+uint8_t bitplaneGetEntry(uint8_t combined, uint8_t paletteIndex) {
+	if(combined == 0) {
+		return 0;
+	}
+	return paletteIndex | combined;
+}
 
-	return 0;
+#define SPRITE_BEHIND 0x80
+#define SPRITE_ZERO 0x40
+
+// sets or clears sprite i's bits on the lines its y puts it on
+void ppuIndexSprite(uint8_t i, uint8_t set) {
+	uint8_t spriteY = ppu->oam[i*4 + 0] + 1;
+	for(uint8_t size = 0; size < 2; ++size) {
+		for(uint16_t line = spriteY; line < spriteY + (size ? 16 : 8) && line < 240; ++line) {
+			if(set) {
+				ppu->oamLines[size][line] |= (uint64_t)1 << i;
+			} else {
+				ppu->oamLines[size][line] &= ~((uint64_t)1 << i);
+			}
+		}
+	}
 }
 
-void uninitRenderer(void) {
-	SDL_DestroySurface(frameBuffer);
-	SDL_DestroyWindowSurface(w);
-	SDL_DestroyWindow(w);
+void ppuRebuildOAMIndex(void) {
+	memset(ppu->oamLines, 0, sizeof(ppu->oamLines));
+	for(uint8_t i = 0; i < 64; ++i) {
+		ppuIndexSprite(i, 1);
+	}
+}
 
-	SDL_Quit();
+// writes through $2004, which oam dma goes through as well
+void ppuOAMWrite(uint8_t addr, uint8_t byte) {
+	if(addr % 4 == 0 && ppu->oam[addr] != byte) {
+		ppuIndexSprite(addr / 4, 0);
+		ppu->oam[addr] = byte;
+		ppuIndexSprite(addr / 4, 1);
+		return;
+	}
+	ppu->oam[addr] = byte;
 }
 
-void debugScreenshot(void) {
-	SDL_SaveBMP(frameBuffer, "framebuffer.bmp");
+// https://www.nesdev.org/wiki/PPU_sprite_evaluation
+void ppuEvaluateSprites(uint16_t y) {
+	ppu->spriteZeroIndex = 9;
+	memset(ppu->secondaryOAM, 0xFF, sizeof(ppu->secondaryOAM));
+	ppu->secondaryOAMIndex = 0;
+	// only the sprites on this line, in the same order as going through all of oam
+	for(uint64_t sprites = ppu->oamLines[(ppu->control & PPU_CTRL_SPRITE_SIZE) != 0][y]; sprites != 0; sprites &= sprites - 1) {
+		uint8_t i = __builtin_ctzll(sprites);
+		uint8_t spriteY = ppu->oam[i*4 + 0] + 1;
+		// not accurately evaluating the sprite overflow stuff
+		if(ppu->secondaryOAMIndex == 8) {
+			ppu->status |= PPU_STATUS_SPRITE_OVERFLOW;
+			break;
+		} else {
+			if(i == 0) { ppu->spriteZeroIndex = ppu->secondaryOAMIndex; }
+			memcpy(&ppu->secondaryOAM[ppu->secondaryOAMIndex*4], &ppu->oam[i*4], 4);
+			++ppu->secondaryOAMIndex;
+			drawDebugText(ppu->oam[i*4 + 3] * 2, spriteY * 2, "%i", i);
+		}
+	}
 }
 
-uint8_t bitplaneGetPixel(uint16_t bitplaneStart, uint16_t x, uint16_t y) {
-	uint8_t bitplane1 = chrReadByte(bitplaneStart + y);
-	uint8_t bitplane2 = chrReadByte(bitplaneStart + 8 + y);
-	return ((bitplane1 >> (7-x)) & 1) | (((bitplane2 >> (7-x)) & 1) << 1);
+// fetches the row of the background tile at vramAddr, or the one after it if next is set
+// https://www.nesdev.org/wiki/PPU_scrolling#Tile_and_attribute_fetching
+uint8_t* ppuFetchTile(uint16_t vramAddr, uint8_t next, uint8_t* paletteIndex) {
+	uint8_t coarseX = vramAddr & COARSE_X;
+	uint8_t coarseY = (vramAddr & COARSE_Y) >> 5;
+	uint8_t fineY = (vramAddr >> 12);
+
+	uint16_t tileAddr = 0x2000 | (vramAddr & 0xFFF);
+	uint16_t attribAddr = 0x23C0 | (vramAddr & (NAMETABLE_X | NAMETABLE_Y)) | ((coarseY & 0x1C) << 1) | (coarseX >> 2);
+	if(next) {
+		if(coarseX % 4 == 3) {
+			attribAddr += 1;
+		}
+		if(coarseX < 31) {
+			++coarseX;
+			++tileAddr;
+		} else {
+			// move into the next nametable
+			coarseX = 0;
+			attribAddr += NAMETABLE_X - 0x1F/4 - 1;
+			tileAddr += NAMETABLE_X - 0x1F;
+			if(tileAddr >= 0x3000) {
+				tileAddr -= 0x1000;
+				attribAddr -= 0x1000;
+			}
+		}
+	}
+
+	uint8_t shift = (coarseX/2) % 2;
+	if((coarseY/2)% 2 == 1) {
+		shift += 2;
+	}
+	shift *= 2;
+
+	uint16_t bank = (ppu->control & PPU_CTRL_BACKGROUND_TABLE ? 0x1000 : 0x0000);
+	uint8_t tileID = ppuRAMRead(tileAddr);
+	uint8_t attrib = ppuRAMRead(attribAddr);
+	*paletteIndex = ((attrib >> shift) & 0x3) << 2;
+
+	return ppuTileRow(bank + tileID*8*2 + fineY, 0);
 }
 
-uint32_t bitplaneGetColor(uint8_t combined, uint8_t paletteIndex) {
-	uint8_t newIndex = paletteIndex | combined;
-	if(combined == 0) {
-		return paletteColors[ppuRAMRead(0x3F00)];
+// the pattern table address of the row of sprite that's on line y
+uint16_t ppuSpriteRowAddr(const uint8_t* sprite, uint16_t y, uint8_t ySize) {
+	uint16_t bank;
+	uint8_t tileID = sprite[1];
+	if(ySize > 8) {
+		bank = (tileID & 1 ? 0x1000 : 0x0000);
+		tileID &= ~1;
 	} else {
-		return paletteColors[ppuRAMRead(0x3F00 + newIndex)] & (combined == 0 ? paletteColors[ppuRAMRead(0x3F00)]: 0xFFFFFFFF);
+		bank = (ppu->control & PPU_CTRL_SPRITE_TABLE ? 0x1000 : 0x0000);
+	}
+	uint16_t bitplane = bank + tileID*8*2;
+	uint8_t yOffset = y - (sprite[0] + 1);
+	if(sprite[2] & PPU_OAM_FLIP_VERTICAL) {
+		yOffset = ySize-1-yOffset;
 	}
+	if(yOffset > 7) {
+		bitplane += 16;
+	}
+	return bitplane + yOffset%8;
 }
 
-uint8_t secondaryOAM[4*8];
-uint8_t secondaryOAMIndex;
-uint8_t spriteZeroIndex;
-
-void drawPixel(uint16_t x, uint16_t y) {
+// the palette index of the first opaque sprite at x, with SPRITE_BEHIND set if it's behind the background, 0 if there isn't one
+uint8_t ppuSpritePixel(uint16_t x, uint16_t y, uint8_t backgroundPixel) {
 	uint8_t ySize = 8;
-	if(ppu.control & PPU_CTRL_SPRITE_SIZE) {
+	if(ppu->control & PPU_CTRL_SPRITE_SIZE) {
 		ySize = 16;
 	}
+	for(uint8_t i = 0; i < 8; ++i) {
+		uint8_t spriteX = ppu->secondaryOAM[i*4 + 3];
+		uint16_t spriteY = ppu->secondaryOAM[i*4 + 0] + 1;
+		uint8_t spriteAttribs = ppu->secondaryOAM[i*4 + 2];
+		if(x < spriteX || x > spriteX + 7 || y < spriteY || y > spriteY + ySize - 1) {
+			   continue;
+		}
+		uint8_t paletteIndex = 0x10 | ((ppu->secondaryOAM[i*4 + 2]&0x3) << 2);
+		uint8_t xOffset = x - spriteX;
+		uint8_t spritePixel = ppuTileRow(ppuSpriteRowAddr(&ppu->secondaryOAM[i*4], y, ySize), (spriteAttribs & PPU_OAM_FLIP_HORIZONTAL) != 0)[xOffset];
+		if(x < 255 && (ppu->status & PPU_STATUS_SPRITE_0) == 0 && i == ppu->spriteZeroIndex && spritePixel != 0 && backgroundPixel != 0) {
+			//printf("sprite 0\n");
+			ppu->status |= PPU_STATUS_SPRITE_0;
+		}
+		if(spritePixel != 0) {
+			return paletteIndex | spritePixel | (spriteAttribs & PPU_OAM_PRIORITY ? SPRITE_BEHIND : 0);
+		}
+	}
+	return 0;
+}
+
+// a frame that isn't going to be shown only needs its pixels on lines where they can still set sprite 0 hit
+// has to be called after the line's sprites are evaluated
+uint8_t ppuNeedsPixels(void) {
+	if(!ppu->skipFrame) {
+		return 1;
+	}
+	uint8_t enabled = PPU_MASK_ENABLE_BACKGROUND | PPU_MASK_ENABLE_SPRITES;
+	return (ppu->status & PPU_STATUS_SPRITE_0) == 0 && ppu->spriteZeroIndex != 9 && (ppu->mask & enabled) == enabled;
+}
+
+void drawPixel(uint16_t x, uint16_t y) {
 	if(x == 0) {
-		spriteZeroIndex = 9;
-		// https://www.nesdev.org/wiki/PPU_sprite_evaluation
-		memset(secondaryOAM, 0xFF, sizeof(secondaryOAM));
-		secondaryOAMIndex = 0;
-		for(uint8_t i = 0; i < 64; ++i) {
-			uint8_t spriteY = ppu.oam[i*4 + 0] + 1;
-			if(y >= spriteY && y < spriteY + ySize) {
-				// not accurately evaluating the sprite overflow stuff
-				if(secondaryOAMIndex == 8) {
-					ppu.status |= PPU_STATUS_SPRITE_OVERFLOW;
-					break;
-				} else {
-					if(i == 0) { spriteZeroIndex = secondaryOAMIndex; }
-					memcpy(&secondaryOAM[secondaryOAMIndex*4], &ppu.oam[i*4], 4);
-					++secondaryOAMIndex;
-					drawDebugText(ppu.oam[i*4 + 3] * 2, spriteY * 2, "%i", i);
-				}
-			}
+		ppuEvaluateSprites(y);
+	}
+	// mmc2's latches still have to see the tiles get read
+	if(!ppuNeedsPixels() && !rom->chrLatch) {
+		return;
+	}
+	uint8_t entry = 0;
+	uint8_t backgroundPixel = 0;
+	if(ppu->mask & PPU_MASK_ENABLE_BACKGROUND && !((ppu->mask & PPU_MASK_LEFT_BACKGROUND) == 0 && x < 8)) {
+		uint8_t fineX = ppu->x + (x % 8);
+		uint8_t paletteIndex;
+		uint8_t* row = ppuFetchTile(ppu->vramAddr, fineX > 7, &paletteIndex);
+		backgroundPixel = row[fineX % 8];
+		entry = bitplaneGetEntry(backgroundPixel, paletteIndex);
+	}
+	if(ppu->mask & PPU_MASK_ENABLE_SPRITES && !((ppu->mask & PPU_MASK_LEFT_SPRITES) == 0 && x < 8)) {
+		uint8_t sprite = ppuSpritePixel(x, y, backgroundPixel);
+		if(sprite != 0 && ((sprite & SPRITE_BEHIND) == 0 || backgroundPixel == 0)) {
+			entry = sprite & 0x1F;
+		}
+	}
+
+	if(ppu->indexedOutput) {
+		if(x < FB_WIDTH && y < FB_HEIGHT) {
+			ppu->frame->indexed[y*FB_WIDTH + x] = ppu->paletteIndexed[entry];
+			ppu->frame->emphasis[y] = ppu->mask >> 5;
 		}
+		return;
 	}
-	uint32_t* target = (uint32_t*)(((uint8_t*)frameBuffer->pixels + x*sizeof(uint32_t)) + y*frameBuffer->pitch);
+	uint32_t* target = &ppu->frame->pixels[y*FB_WIDTH + x];
 	// mmc2 requires an extra tile to be read at the end of the scanline
 	// this is to avoid needing to change the rest of the code to have ifs in them
 	// should probably move chr rom reading stuff into their own functions and call them in ppuStep instead
 	uint32_t asdf;
-	if(x > 256 || y > 240) {
+	if(x >= FB_WIDTH || y >= FB_HEIGHT) {
 		target = &asdf;
 	}
+	*target = ppu->paletteRGBA[entry];
+}
 
-	uint8_t backgroundPixel = 0;
-	// incredibly messy code
-	if(ppu.mask & PPU_MASK_ENABLE_BACKGROUND && !((ppu.mask & PPU_MASK_LEFT_BACKGROUND) == 0 && x < 8)) {
-		// https://www.nesdev.org/wiki/PPU_scrolling#Tile_and_attribute_fetching
-		uint8_t coarseX = ppu.vramAddr & COARSE_X;
-		uint8_t coarseY = (ppu.vramAddr & COARSE_Y) >> 5;
-		uint8_t fineX = ppu.x + (x % 8);
-		uint8_t fineY = (ppu.vramAddr >> 12);
-
-		uint16_t tileAddr = 0x2000 | (ppu.vramAddr & 0xFFF);
-		uint16_t attribAddr = 0x23C0 | (ppu.vramAddr & (NAMETABLE_X | NAMETABLE_Y)) | ((coarseY & 0x1C) << 1) | (coarseX >> 2);
-		if(fineX > 7) {
-			if(coarseX % 4 == 3) {
-				attribAddr += 1;
-			}
-			if(coarseX < 31) {
-				++coarseX;
-				++tileAddr;
-			} else {
-				// move into the next nametable
-				coarseX = 0;
-				attribAddr += NAMETABLE_X - 0x1F/4 - 1;
-				tileAddr += NAMETABLE_X - 0x1F;
-				if(tileAddr >= 0x3000) {
-					tileAddr -= 0x1000;
-					attribAddr -= 0x1000;
-				}
+// https://www.nesdev.org/wiki/PPU_scrolling#Wrapping_around
+uint16_t ppuIncrementedX(uint16_t vramAddr) {
+	if((vramAddr & COARSE_X) == 31) {
+		vramAddr &= ~COARSE_X;
+		vramAddr ^= NAMETABLE_X;
+	} else {
+		++vramAddr; // increment coarse x
+	}
+	return vramAddr;
+}
+
+void ppuIncrementX(void) {
+	ppu->vramAddr = ppuIncrementedX(ppu->vramAddr);
+}
+
+void ppuIncrementY(void) {
+	if((ppu->vramAddr & FINE_Y) != 0x7000) {
+		ppu->vramAddr += 0x1000; // increment fine y
+	} else {
+		ppu->vramAddr &= ~FINE_Y;
+		uint8_t coarseY = (ppu->vramAddr & COARSE_Y) >> 5;
+		if(coarseY == 29) {
+			ppu->vramAddr &= ~COARSE_Y;
+			ppu->vramAddr ^= NAMETABLE_Y;
+		} else if(coarseY == 31) {
+			ppu->vramAddr &= ~COARSE_Y;
+		} else {
+			ppu->vramAddr += 0x20; // increment coarse y
+		}
+	}
+}
+
+// copy horizontal bits from ppu.t to ppu.vramAddr
+void ppuCopyX(void) {
+	ppu->vramAddr &= ~(COARSE_X | NAMETABLE_X);
+	ppu->vramAddr |= ppu->t & (COARSE_X | NAMETABLE_X);
+}
+
+// fills sprites with what ppuSpritePixel() would give for every pixel on line y, with SPRITE_ZERO set where it comes from sprite 0
+// sprites has to have room for 8 pixels past the end of the line
+void ppuSpriteLine(uint8_t* sprites, uint16_t y) {
+	uint8_t ySize = ppu->control & PPU_CTRL_SPRITE_SIZE ? 16 : 8;
+	memset(sprites, 0, FB_WIDTH + 8);
+	for(uint8_t i = 0; i < ppu->secondaryOAMIndex; ++i) {
+		uint8_t* sprite = &ppu->secondaryOAM[i*4];
+		// sprites at y 255 get evaluated onto the top lines but ppuSpritePixel() never draws them
+		if(sprite[0] + 1 > y) {
+			continue;
+		}
+		uint8_t* tileRow = ppuTileRow(ppuSpriteRowAddr(sprite, y, ySize), (sprite[2] & PPU_OAM_FLIP_HORIZONTAL) != 0);
+		uint8_t attribs = 0x10 | ((sprite[2]&0x3) << 2);
+		attribs |= sprite[2] & PPU_OAM_PRIORITY ? SPRITE_BEHIND : 0;
+		attribs |= i == ppu->spriteZeroIndex ? SPRITE_ZERO : 0;
+		// earlier sprites are in front of later ones
+		uint8_t* target = &sprites[sprite[3]];
+		for(uint8_t x = 0; x < 8; ++x) {
+			if(target[x] == 0 && tileRow[x] != 0) {
+				target[x] = attribs | tileRow[x];
 			}
 		}
-		fineX %= 8;
-		if(fineY > 7) {
-			tileAddr += 256/8;
-			++coarseY;
+	}
+}
+
+// gives the pixels of a background tile row their palette, 0 stays 0 so the backdrop shows through
+static inline void ppuPaletteTileRow(uint8_t* target, const uint8_t* tileRow, uint8_t paletteIndex) {
+	#ifdef __SSE2__
+		__m128i pixels = _mm_loadl_epi64((const __m128i*)tileRow);
+		__m128i transparent = _mm_cmpeq_epi8(pixels, _mm_setzero_si128());
+		pixels = _mm_or_si128(pixels, _mm_andnot_si128(transparent, _mm_set1_epi8(paletteIndex)));
+		_mm_storel_epi64((__m128i*)target, pixels);
+	#else
+		for(uint8_t i = 0; i < 8; ++i) {
+			target[i] = tileRow[i] ? tileRow[i] | paletteIndex : 0;
 		}
-		fineY %= 8;
+	#endif
+}
 
-		uint8_t shift = (coarseX/2) % 2;
-		if((coarseY/2)% 2 == 1) {
-			shift += 2;
+// the line kernels work on a line of palette indices, they get picked in initRenderer() depending on what the cpu supports
+// sprites are drawn over the background where they're opaque and either in front of it or over a transparent part of it
+void mergeSpritesScalar(uint8_t* line, const uint8_t* sprites) {
+	for(uint16_t x = 0; x < FB_WIDTH; ++x) {
+		if(sprites[x] != 0 && ((sprites[x] & SPRITE_BEHIND) == 0 || line[x] == 0)) {
+			line[x] = sprites[x] & 0x1F;
 		}
-		shift *= 2;
+	}
+}
 
-		uint16_t bank = (ppu.control & PPU_CTRL_BACKGROUND_TABLE ? 0x1000 : 0x0000);
-		uint8_t tileID = ppuRAMRead(tileAddr);
-		uint8_t attrib = ppuRAMRead(attribAddr);
-		uint8_t paletteIndex = ((attrib >> shift) & 0x3) << 2;
+void expandLineScalar(uint32_t* target, const uint8_t* line, const uint32_t* colors) {
+	for(uint16_t x = 0; x < FB_WIDTH; ++x) {
+		target[x] = colors[line[x]];
+	}
+}
 
-		backgroundPixel = bitplaneGetPixel(bank + tileID*8*2, fineX % 8, fineY % 8);
-		*target = bitplaneGetColor(backgroundPixel, paletteIndex);
-	} else {
-		*target = paletteColors[ppuRAMRead(0x3f00)];
+void expandLineIndexedScalar(uint8_t* target, const uint8_t* line, const uint8_t* colors) {
+	for(uint16_t x = 0; x < FB_WIDTH; ++x) {
+		target[x] = colors[line[x]];
 	}
-	if(ppu.mask & PPU_MASK_ENABLE_SPRITES && !((ppu.mask & PPU_MASK_LEFT_SPRITES) == 0 && x < 8)) {
-		for(uint8_t i = 0; i < 8; ++i) {
-			uint8_t spriteX = secondaryOAM[i*4 + 3];
-			uint16_t spriteY = secondaryOAM[i*4 + 0] + 1;
-			uint8_t spriteAttribs = secondaryOAM[i*4 + 2];
-			if(x < spriteX || x > spriteX + 7 || y < spriteY || y > spriteY + ySize - 1) {
-				   continue;
-			}
-			uint16_t bank;
-			uint8_t tileID = secondaryOAM[i*4 + 1];
-			uint8_t paletteIndex = 0x10 | ((secondaryOAM[i*4 + 2]&0x3) << 2);
-			if(ySize > 8) {
-				bank = (tileID & 1 ? 0x1000 : 0x0000);
-				tileID &= ~1;
-			} else {
-				bank = (ppu.control & PPU_CTRL_SPRITE_TABLE ? 0x1000 : 0x0000);
-			}
-			uint16_t bitplane = bank + tileID*8*2;
-			uint8_t xOffset = x - spriteX;
-			uint8_t yOffset = y - spriteY;
-			if(spriteAttribs & PPU_OAM_FLIP_HORIZONTAL) {
-				xOffset = 7-xOffset;
-			}
-			if(spriteAttribs & PPU_OAM_FLIP_VERTICAL) {
-				yOffset = ySize-1-yOffset;
+}
+
+#ifdef __SSE2__
+void mergeSpritesSSE2(uint8_t* line, const uint8_t* sprites) {
+	__m128i zero = _mm_setzero_si128();
+	for(uint16_t x = 0; x < FB_WIDTH; x += 16) {
+		__m128i background = _mm_loadu_si128((const __m128i*)&line[x]);
+		__m128i sprite = _mm_loadu_si128((const __m128i*)&sprites[x]);
+		__m128i front = _mm_cmpeq_epi8(_mm_and_si128(sprite, _mm_set1_epi8((char)SPRITE_BEHIND)), zero);
+		__m128i show = _mm_or_si128(front, _mm_cmpeq_epi8(background, zero));
+		show = _mm_andnot_si128(_mm_cmpeq_epi8(sprite, zero), show);
+		sprite = _mm_and_si128(sprite, _mm_set1_epi8(0x1F));
+		background = _mm_or_si128(_mm_and_si128(show, sprite), _mm_andnot_si128(show, background));
+		_mm_storeu_si128((__m128i*)&line[x], background);
+	}
+}
+#endif
+
+#ifdef PPU_AVX2
+__attribute__((target("avx2")))
+void mergeSpritesAVX2(uint8_t* line, const uint8_t* sprites) {
+	__m256i zero = _mm256_setzero_si256();
+	for(uint16_t x = 0; x < FB_WIDTH; x += 32) {
+		__m256i background = _mm256_loadu_si256((const __m256i*)&line[x]);
+		__m256i sprite = _mm256_loadu_si256((const __m256i*)&sprites[x]);
+		__m256i front = _mm256_cmpeq_epi8(_mm256_and_si256(sprite, _mm256_set1_epi8((char)SPRITE_BEHIND)), zero);
+		__m256i show = _mm256_or_si256(front, _mm256_cmpeq_epi8(background, zero));
+		show = _mm256_andnot_si256(_mm256_cmpeq_epi8(sprite, zero), show);
+		sprite = _mm256_and_si256(sprite, _mm256_set1_epi8(0x1F));
+		background = _mm256_blendv_epi8(background, sprite, show);
+		_mm256_storeu_si256((__m256i*)&line[x], background);
+	}
+}
+
+__attribute__((target("avx2")))
+void expandLineAVX2(uint32_t* target, const uint8_t* line, const uint32_t* colors) {
+	for(uint16_t x = 0; x < FB_WIDTH; x += 8) {
+		__m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&line[x]));
+		_mm256_storeu_si256((__m256i*)&target[x], _mm256_i32gather_epi32((const int*)colors, indices, 4));
+	}
+}
+
+// the 32 entry table is split into two 16 byte halves that get looked up with shuffles
+__attribute__((target("avx2")))
+void expandLineIndexedAVX2(uint8_t* target, const uint8_t* line, const uint8_t* colors) {
+	__m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)colors));
+	__m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&colors[16]));
+	__m256i highBit = _mm256_set1_epi8(0x10);
+	for(uint16_t x = 0; x < FB_WIDTH; x += 32) {
+		__m256i indices = _mm256_loadu_si256((const __m256i*)&line[x]);
+		__m256i useHigh = _mm256_cmpeq_epi8(_mm256_and_si256(indices, highBit), highBit);
+		__m256i result = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, indices), _mm256_shuffle_epi8(high, indices), useHigh);
+		_mm256_storeu_si256((__m256i*)&target[x], result);
+	}
+}
+#endif
+
+void (*mergeSprites)(uint8_t* line, const uint8_t* sprites) = mergeSpritesScalar;
+void (*expandLine)(uint32_t* target, const uint8_t* line, const uint32_t* colors) = expandLineScalar;
+void (*expandLineIndexed)(uint8_t* target, const uint8_t* line, const uint8_t* colors) = expandLineIndexedScalar;
+
+void ppuSelectKernels(void) {
+	#ifdef __SSE2__
+		mergeSprites = mergeSpritesSSE2;
+	#endif
+	#ifdef PPU_AVX2
+		if(__builtin_cpu_supports("avx2")) {
+			mergeSprites = mergeSpritesAVX2;
+			expandLine = expandLineAVX2;
+			expandLineIndexed = expandLineIndexedAVX2;
+		}
+	#endif
+}
+
+// draws visible line y
+// this fetches each tile once for 8 pixels instead of once per pixel, so it can only be used when
+// the ppu can't change partway through the line and chr reads don't switch banks
+void ppuDrawScanline(uint16_t y) {
+	// palette indices for the line before it's scrolled by ppu.x, tile t is at 8*t and the 33rd one only shows up when ppu.x isn't 0
+	uint8_t background[FB_WIDTH + 16] = {0};
+	uint8_t* line = &background[ppu->x];
+	if(ppu->mask & PPU_MASK_ENABLE_BACKGROUND) {
+		uint16_t vramAddr = ppu->vramAddr;
+		uint8_t wrapped[8];
+		uint8_t wrappedTile = 0;
+		for(uint8_t t = 0; t < (ppu->x ? 33 : 32); ++t) {
+			uint8_t paletteIndex;
+			uint8_t* tileRow = ppuFetchTile(vramAddr, 0, &paletteIndex);
+			ppuPaletteTileRow(&background[t*8], tileRow, paletteIndex);
+			if(ppu->x != 0 && t < 32 && (vramAddr & COARSE_X) == 31) {
+				// drawPixel() doesn't go into the next nametable the same way ppuIncrementedX() does,
+				// so the start of the next tile has to come from wherever it would have looked
+				tileRow = ppuFetchTile(vramAddr, 1, &paletteIndex);
+				ppuPaletteTileRow(wrapped, tileRow, paletteIndex);
+				wrappedTile = t + 1;
 			}
-			if(yOffset > 7) {
-				bitplane += 16;
+			vramAddr = ppuIncrementedX(vramAddr);
+		}
+		if(wrappedTile != 0) {
+			memcpy(&background[wrappedTile*8], wrapped, ppu->x);
+		}
+	}
+	if((ppu->mask & PPU_MASK_LEFT_BACKGROUND) == 0) {
+		memset(line, 0, 8);
+	}
+	if(ppu->mask & PPU_MASK_ENABLE_SPRITES && ppu->secondaryOAMIndex != 0) {
+		uint8_t sprites[FB_WIDTH + 8];
+		ppuSpriteLine(sprites, y);
+		if((ppu->mask & PPU_MASK_LEFT_SPRITES) == 0) {
+			memset(sprites, 0, 8);
+		}
+		if((ppu->status & PPU_STATUS_SPRITE_0) == 0 && ppu->spriteZeroIndex != 9) {
+			for(uint16_t x = 0; x < 255; ++x) {
+				if(sprites[x] & SPRITE_ZERO && line[x] != 0) {
+					ppu->status |= PPU_STATUS_SPRITE_0;
+					break;
+				}
 			}
-			uint8_t spritePixel = bitplaneGetPixel(bitplane, xOffset%8, yOffset%8);
-			if(x < 255 && (ppu.status & PPU_STATUS_SPRITE_0) == 0 && i == spriteZeroIndex && spritePixel != 0 && backgroundPixel != 0) {
-				//printf("sprite 0\n");
-				ppu.status |= PPU_STATUS_SPRITE_0;
+		}
+		if(!ppu->skipFrame) {
+			mergeSprites(line, sprites);
+		}
+	}
+	if(ppu->skipFrame) {
+		return;
+	}
+	if(ppu->indexedOutput) {
+		expandLineIndexed(&ppu->frame->indexed[y*FB_WIDTH], line, ppu->paletteIndexed);
+		ppu->frame->emphasis[y] = ppu->mask >> 5;
+	} else {
+		expandLine(&ppu->frame->pixels[y*FB_WIDTH], line, ppu->paletteRGBA);
+	}
+}
+
+// draws visible line y if it needs to be and does everything ppuStep() would have done over its 341 dots
+void ppuRenderScanline(uint16_t y) {
+	ppuEvaluateSprites(y);
+	if(ppuNeedsPixels()) {
+		ppuDrawScanline(y);
+	}
+	// the horizontal increments all get overwritten when the horizontal bits get copied from ppu.t at dot 257
+	if(ppu->mask & (PPU_MASK_ENABLE_BACKGROUND | PPU_MASK_ENABLE_SPRITES)) {
+		ppuIncrementY();
+		ppuCopyX();
+	}
+	rom->scanlineCounter();
+	ppu->currentPixel += 341;
+}
+
+uint32_t ppuDotsUntil(uint32_t dot) {
+	return ppu->currentPixel <= dot ? dot - ppu->currentPixel : 341*262 - ppu->currentPixel + dot;
+}
+
+// how many cpu cycles from now the ppu raises the vblank nmi, UINT32_MAX if it's disabled
+// cycle n is the one that runs dots n*3 to n*3+2 from the current one
+uint32_t ppuCyclesUntilNMI(void) {
+	if(!(ppu->control & PPU_CTRL_ENABLE_VBLANK)) {
+		return UINT32_MAX;
+	}
+	if(!ppu->nmiHappened && ppu->status & PPU_STATUS_VBLANK) {
+		return 0;
+	}
+	return ppuDotsUntil(241*341 + 1) / 3;
+}
+
+// how many cpu cycles from now until ppuStep() clocks the mapper's scanline counter for the countth time
+uint32_t ppuCyclesUntilScanlineCounter(uint16_t count) {
+	uint32_t line = ppu->currentPixel / 341;
+	if(ppu->currentPixel % 341 > 260) {
+		++line;
+	}
+	while(1) {
+		uint16_t y = line % 262;
+		if(y < 240 || y == 261) {
+			--count;
+			if(count == 0) {
+				return (line*341 + 260 - ppu->currentPixel) / 3;
 			}
-			if(spritePixel != 0) {
-				if((spriteAttribs & PPU_OAM_PRIORITY) == 0 || backgroundPixel == 0) {
-					*target = bitplaneGetColor(spritePixel, paletteIndex);
-				}
-				break;
+		}
+		++line;
+	}
+}
+
+// how many cpu cycles from now reading $2002 could start giving something different, as long as nothing gets written to the ppu
+uint32_t ppuCyclesUntilStatusChange(void) {
+	// reading it clears vblank
+	if(ppu->status & PPU_STATUS_VBLANK) {
+		return 0;
+	}
+	uint32_t dots = ppuDotsUntil(241*341 + 1);
+	uint32_t clearDots = ppuDotsUntil(261*341 + 1);
+	if(clearDots < dots) {
+		dots = clearDots;
+	}
+	uint16_t y = ppu->currentPixel / 341;
+	if(y >= 240 || (ppu->status & (PPU_STATUS_SPRITE_0 | PPU_STATUS_SPRITE_OVERFLOW)) == (PPU_STATUS_SPRITE_0 | PPU_STATUS_SPRITE_OVERFLOW)) {
+		return dots / 3;
+	}
+	// find the first line where drawPixel() could set sprite 0 hit or overflow, using the same sprite index it does
+	uint64_t* lines = ppu->oamLines[(ppu->control & PPU_CTRL_SPRITE_SIZE) != 0];
+	for(uint16_t line = y; line < 240; ++line) {
+		// sprite 0 being on a line at all is enough to count
+		if((lines[line] & 1) || __builtin_popcountll(lines[line]) >= 9) {
+			if(line == y) {
+				return 0;
 			}
+			uint32_t lineDots = ppuDotsUntil(line*341);
+			return (lineDots < dots ? lineDots : dots) / 3;
 		}
 	}
+	return dots / 3;
 }
 
 void ppuStep(void) {
-	uint16_t x = ppu.currentPixel % 341;
-	uint16_t y = ppu.currentPixel / 341;
+	uint16_t x = ppu->currentPixel % 341;
+	uint16_t y = ppu->currentPixel / 341;
 	if(y == 261 && x == 1) {
-		ppu.status &= ~PPU_STATUS_SPRITE_0;
-		ppu.status &= ~PPU_STATUS_VBLANK;
-		ppu.status &= ~PPU_STATUS_SPRITE_OVERFLOW;
-		ppu.nmiHappened = 0;
+		ppu->status &= ~PPU_STATUS_SPRITE_0;
+		ppu->status &= ~PPU_STATUS_VBLANK;
+		ppu->status &= ~PPU_STATUS_SPRITE_OVERFLOW;
+		ppu->nmiHappened = 0;
 	}
 	if(y == 241 && x == 1) {
-		ppu.status |= PPU_STATUS_VBLANK;
-		apuPrintDebug();
-		render();
+		ppu->status |= PPU_STATUS_VBLANK;
+		ppu->frameDone();
+		if(++ppu->framesSkipped >= ppu->frameSkip) {
+			ppu->framesSkipped = 0;
+		}
+		ppu->skipFrame = ppu->framesSkipped != 0;
 	}
-	if(!ppu.nmiHappened && ppu.control & PPU_CTRL_ENABLE_VBLANK && ppu.status & PPU_STATUS_VBLANK) {
-		cpu.nmi = 0;
-		ppu.nmiHappened = 1;
+	if(!ppu->nmiHappened && ppu->control & PPU_CTRL_ENABLE_VBLANK && ppu->status & PPU_STATUS_VBLANK) {
+		cpu->nmi = 0;
+		ppu->nmiHappened = 1;
 	}
 	// https://www.nesdev.org/wiki/PPU_scrolling#Wrapping_around
-	if(ppu.mask & (PPU_MASK_ENABLE_BACKGROUND | PPU_MASK_ENABLE_SPRITES)) {
+	if(ppu->mask & (PPU_MASK_ENABLE_BACKGROUND | PPU_MASK_ENABLE_SPRITES)) {
 		if(y < 240 || y == 261) {
 			if(x == 256) {
-				// increment ppu.vramAddr vertically
-				if((ppu.vramAddr & FINE_Y) != 0x7000) {
-					ppu.vramAddr += 0x1000; // increment fine y
-				} else {
-					ppu.vramAddr &= ~FINE_Y;
-					uint8_t coarseY = (ppu.vramAddr & COARSE_Y) >> 5;
-					if(coarseY == 29) {
-						ppu.vramAddr &= ~COARSE_Y;
-						ppu.vramAddr ^= NAMETABLE_Y;
-					} else if(coarseY == 31) {
-						ppu.vramAddr &= ~COARSE_Y;
-					} else {
-						ppu.vramAddr += 0x20; // increment coarse y
-					}
-				}
+				ppuIncrementY();
 			}
 			if(x == 257) {
-				// copy horizontal bits from ppu.t to ppu.vramAddr
-				ppu.vramAddr &= ~(COARSE_X | NAMETABLE_X);
-				ppu.vramAddr |= ppu.t & (COARSE_X | NAMETABLE_X);
+				ppuCopyX();
 			}
 			if(x != 0 && x % 8 == 0 && x <= 256) {
-				// increment ppu.vramAddr horizontally
-				if((ppu.vramAddr & COARSE_X) == 31) {
-					ppu.vramAddr &= ~COARSE_X;
-					ppu.vramAddr ^= NAMETABLE_X;
-				} else {
-					++ppu.vramAddr; // increment coarse x
-				}
+				ppuIncrementX();
 			}
 		}
 		if(y == 261 && x >= 280 && x <= 304) {
 			// copy vertical bits from ppu.t to ppu.vramAddr
-			ppu.vramAddr &= ~(FINE_Y | NAMETABLE_Y | COARSE_Y);
-			ppu.vramAddr |= ppu.t & (FINE_Y | NAMETABLE_Y | COARSE_Y);
+			ppu->vramAddr &= ~(FINE_Y | NAMETABLE_Y | COARSE_Y);
+			ppu->vramAddr |= ppu->t & (FINE_Y | NAMETABLE_Y | COARSE_Y);
 		}
 	}
 	if(x == 260 && (y < 240 || y == 261)) {
-		scanlineCounter();
+		rom->scanlineCounter();
 	}
 	if(x < 321 && y < 240) {
 		drawPixel(x, y);
 	}
 
-	if(ppu.currentPixel < 341*262 - 1) {
-		++ppu.currentPixel;
+	if(ppu->currentPixel < 341*262 - 1) {
+		++ppu->currentPixel;
 	} else {
-		ppu.currentPixel = 0;
+		ppu->currentPixel = 0;
 	}
 }
 
-void render(void) {
-	SDL_BlitSurfaceScaled(frameBuffer, &(SDL_Rect){0,0,FB_WIDTH,FB_HEIGHT}, windowSurface, &(SDL_Rect){0,0,SCREEN_WIDTH,SCREEN_HEIGHT}, SDL_SCALEMODE_NEAREST);
-
-	renderDebugInfo(windowSurface);
-	SDL_UpdateWindowSurface(w);
-
-	if(!fpsUncap) {
-		static uint64_t lastTicks = 0;
-		if(lastTicks == 0) {
-			lastTicks = SDL_GetTicksNS();
+// runs the ppu until it's done its 3 dots for every cpu cycle before cycle
+// returns 1 if inputPoll() wants to quit
+uint8_t ppuRunUntil(uint64_t cycle) {
+	uint8_t quit = 0;
+	uint64_t target = cycle * 3;
+	while(ppu->dots < target) {
+		if(ppu->currentPixel == 0) {
+			if(input->poll() != 0) { quit = 1; }
+		}
+		// past the visible lines ppuStep() doesn't do anything but start vblank and raise the nmi,
+		// the nmi can only get enabled by writing to the ppu so checking it once is enough for a whole run of dots
+		uint32_t vblankDot = 241*341 + 1;
+		if(ppu->currentPixel >= 240*341 && ppu->currentPixel < 261*341 && ppu->currentPixel != vblankDot) {
+			uint32_t end = ppu->currentPixel < vblankDot ? vblankDot : 261*341;
+			uint64_t dots = end - ppu->currentPixel;
+			if(dots > target - ppu->dots) {
+				dots = target - ppu->dots;
+			}
+			if(!ppu->nmiHappened && ppu->control & PPU_CTRL_ENABLE_VBLANK && ppu->status & PPU_STATUS_VBLANK) {
+				cpu->nmi = 0;
+				ppu->nmiHappened = 1;
+			}
+			ppu->currentPixel += dots;
+			ppu->dots += dots;
+			continue;
 		}
-		uint64_t currentTicks = SDL_GetTicksNS();
-		if(currentTicks - lastTicks < 1000000000/60) {
-			SDL_DelayNS(1000000000/60 - (currentTicks - lastTicks));
+		#ifndef PPU_DOT_RENDERER
+		// a visible line the cpu doesn't touch the ppu partway through gets drawn all at once,
+		// a line with a register access in it gets split between two runs and goes through ppuStep() dot by dot
+		if(ppu->currentPixel % 341 == 0 && ppu->currentPixel < 240*341 && target - ppu->dots >= 341 && !rom->chrLatch) {
+			ppuRenderScanline(ppu->currentPixel / 341);
+			ppu->dots += 341;
+			continue;
 		}
-		lastTicks = SDL_GetTicksNS();
+		#endif
+		ppuStep();
+		++ppu->dots;
 	}
-}
-
-void toggleFPSCap(void) {
-	fpsUncap = !fpsUncap;
+	return quit;
 }
@@ -44,6 +44,16 @@ enum {
 #define PPU_OAM_PRIORITY 0x20
 #define PPU_OAM_FLIP_HORIZONTAL 0x40
 #define PPU_OAM_FLIP_VERTICAL 0x80
+// https://www.nesdev.org/wiki/PPU_palettes
+// with ppu.indexedOutput set frames are drawn as a byte per pixel of the nes color (0-63) in indexed,
+// with the emphasis bits (ppu.mask >> 5) of each line in emphasis, they only get converted to rgba when they're presented
+// a byte can't fit the emphasis bits as well as the color, so a line that changes them partway through gets the last ones
+typedef struct {
+	uint32_t pixels[FB_WIDTH*FB_HEIGHT];
+	uint8_t indexed[FB_WIDTH*FB_HEIGHT];
+	uint8_t emphasis[FB_HEIGHT];
+} frame_t;
+
 //https://www.nesdev.org/wiki/PPU_registers
 typedef struct {
 	uint8_t control;
@@ -60,23 +70,65 @@ typedef struct {
 
 	uint32_t currentPixel;
 	uint8_t nmiHappened;
+	// dots run since power on
+	uint64_t dots;
+
+	uint8_t nametables[2][0x400];
+	// https://www.nesdev.org/wiki/PPU_memory_map
+	// 1k pointers for $0000-$1FFF and $2000-$2FFF, set by the mappers with mapCHR() and ppuSetMirroring()
+	uint8_t* patternBanks[16];
+	uint8_t* nametableBanks[4];
+	uint8_t paletteRAM[0x20];
+	// what each palette ram entry looks like with the current grayscale and emphasis bits, kept up to date by ppuRAMWrite() and ppuMaskWrite()
+	uint32_t paletteRGBA[0x20];
+	// the same thing as nes colors for the indexed frame, only the grayscale bit gets applied to these
+	uint8_t paletteIndexed[0x20];
+
+	uint8_t secondaryOAM[4*8];
+	uint8_t secondaryOAMIndex;
+	uint8_t spriteZeroIndex;
+	// which sprites are on each visible line, as a bit for each sprite number
+	// the first set is for 8x8 sprites and the second is for 8x16 ones so changing the sprite size doesn't need them rebuilt
+	uint64_t oamLines[2][240];
+
+	// the frame being drawn, frameDone can hand it off and point this at a new one
+	frame_t* frame;
+	// called at the start of every frame's vblank, skipFrame says whether it got drawn
+	void (*frameDone)(void);
+	// draw frames as nes colors in frame->indexed instead of rgba
+	uint8_t indexedOutput;
+	// only one out of every frameSkip frames gets drawn and shown, 1 shows all of them
+	// the others still do everything the cpu can see (scrolling, vblank, sprite 0 hit and overflow, mapper irqs) but skip the pixels
+	uint8_t frameSkip;
+	uint8_t skipFrame;
+	uint8_t framesSkipped;
+	// mmc2's rows can't come from the tile cache, they get decoded into here
+	uint8_t latchRow[8];
 } ppu_t;
 
-extern ppu_t ppu;
+extern __thread ppu_t* ppu;
 
 void ppuRAMWrite(uint16_t addr, uint8_t byte);
+void ppuOAMWrite(uint8_t addr, uint8_t byte);
+void ppuMaskWrite(uint8_t byte);
+void ppuRebuildOAMIndex(void);
 uint8_t ppuRAMRead(uint16_t addr);
+uint8_t ppuCHRRead(uint16_t addr);
+void ppuSetMirroring(uint8_t mode);
 
-uint8_t initRenderer(void);
-void uninitRenderer(void);
+void ppuIndexedToRGBA(frame_t* frame);
 
-void debugScreenshot(void);
-
-void toggleFPSCap(void);
+uint8_t initRenderer(void);
+void ppuInit(void);
 
 void ppuStep(void);
+uint8_t ppuRunUntil(uint64_t cycle);
+uint32_t ppuDotsUntil(uint32_t dot);
+uint32_t ppuCyclesUntilNMI(void);
+uint32_t ppuCyclesUntilStatusChange(void);
+uint32_t ppuCyclesUntilScanlineCounter(uint16_t count);
 
+void ppuSelectKernels(void);
 void drawPixel(uint16_t x, uint16_t y);
-void render(void);
 
 #endif
@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "cpu.h"
 #include "rom.h"
@@ -9,13 +10,101 @@
 #include "apu.h"
 #include "input.h"
 #include "dma.h"
+#include "scheduler.h"
+#include "jit.h"
 
-uint8_t cpuRAM[0x800];
+__thread ram_t* ram;
 
-uint8_t prgRAM[0x2000];
+void ramAddCodeRegion(uint8_t* memory, size_t size) {
+	if(ram->codeRegionCount >= MAX_CODE_REGIONS) {
+		return;
+	}
+	cpuDecoded_t* code = calloc(size, sizeof(cpuDecoded_t));
+	if(!code) {
+		return;
+	}
+	ram->codeRegions[ram->codeRegionCount].memory = memory;
+	ram->codeRegions[ram->codeRegionCount].size = size;
+	ram->codeRegions[ram->codeRegionCount].code = code;
+	++ram->codeRegionCount;
+}
+
+cpuDecoded_t* ramCodeFor(uint8_t* memory) {
+	for(uint8_t i = 0; i < ram->codeRegionCount; ++i) {
+		if(memory >= ram->codeRegions[i].memory && memory < ram->codeRegions[i].memory + ram->codeRegions[i].size) {
+			return ram->codeRegions[i].code + (memory - ram->codeRegions[i].memory);
+		}
+	}
+	return NULL;
+}
+
+void ramMapReadPages(uint16_t addr, uint32_t size, uint8_t* memory) {
+	cpuDecoded_t* code = memory ? ramCodeFor(memory) : NULL;
+	for(uint32_t i = 0; i < size; i += 0x100) {
+		ram->readPages[(addr + i) >> 8] = memory ? memory + i : NULL;
+		ram->codePages[(addr + i) >> 8] = code ? code + i : NULL;
+	}
+}
+
+// called after code gets decoded from the page addr is in
+// if it's writable memory every page it's mirrored to has writes go through ramWriteHandler until one happens
+void ramProtectCode(uint16_t addr) {
+	uint8_t* page = ram->writePages[addr >> 8];
+	if(!page) {
+		return;
+	}
+	for(uint16_t i = 0; i < 256; ++i) {
+		if(ram->writePages[i] == page) {
+			ram->protectedPages[i] = page;
+			ram->writePages[i] = NULL;
+		}
+	}
+}
 
-uint8_t ramDataBus;
-uint8_t ppuDataBus;
+// throws out the decoded code in a protected page and gives it its write pages back
+void ramUnprotectCode(uint8_t* page) {
+	cpuDecoded_t* code = ramCodeFor(page);
+	if(code) {
+		memset(code, 0, sizeof(cpuDecoded_t) * 0x100);
+		#ifdef JIT
+			jitInvalidate(code, 0x100);
+		#endif
+	}
+	for(uint16_t i = 0; i < 256; ++i) {
+		if(ram->protectedPages[i] == page) {
+			ram->writePages[i] = page;
+			ram->protectedPages[i] = NULL;
+		}
+	}
+}
+
+void ramMapWritePages(uint16_t addr, uint32_t size, uint8_t* memory) {
+	for(uint32_t i = 0; i < size; i += 0x100) {
+		ram->writePages[(addr + i) >> 8] = memory ? memory + i : NULL;
+	}
+}
+
+// prg rom pages are set up by the mapper, this needs to be called after the rom is loaded
+void ramInit(void) {
+	ramAddCodeRegion(ram->cpuRAM, sizeof(ram->cpuRAM));
+	ramAddCodeRegion(ram->prgRAM, sizeof(ram->prgRAM));
+	// weird ram mirroring
+	for(uint16_t i = 0; i < 0x2000; i += 0x800) {
+		ramMapReadPages(i, 0x800, ram->cpuRAM);
+		ramMapWritePages(i, 0x800, ram->cpuRAM);
+	}
+	if(rom->prgRAMEnabled) {
+		ramMapReadPages(0x6000, 0x2000, ram->prgRAM);
+		ramMapWritePages(0x6000, 0x2000, ram->prgRAM);
+	}
+}
+
+void ramUninit(void) {
+	for(uint8_t i = 0; i < ram->codeRegionCount; ++i) {
+		free(ram->codeRegions[i].code);
+	}
+	ram->codeRegionCount = 0;
+}
 
 // https://www.nesdev.org/wiki/CPU_memory_map
 uint16_t addrMap(uint16_t addr) {
@@ -29,110 +118,120 @@ uint16_t addrMap(uint16_t addr) {
 
 	return addr;
 }
-void ramWriteByte(uint16_t addr, uint8_t byte) {
-	ramDataBus = byte;
+// only reached for pages that aren't mapped straight to memory
+void ramWriteHandler(uint16_t addr, uint8_t byte) {
+	uint8_t* page = ram->protectedPages[addr >> 8];
+	if(page) {
+		ramUnprotectCode(page);
+		page[addr & 0xFF] = byte;
+		return;
+	}
+	schedulerAccess();
 	addr = addrMap(addr);
 	// jank, needs to be changed eventually
-	if(rom.isNSF && addr >= 0x5FF8 && addr <= 0x5FFF) {
-		romWriteByte(addr, byte);
+	if(rom->isNSF && addr >= 0x5FF8 && addr <= 0x5FFF) {
+		rom->romWriteByte(addr, byte);
 		return;
 	}
 
-	if(rom.prgRAMEnabled && addr >= 0x6000 && addr < 0x8000) {
-		prgRAM[addr - 0x6000] = byte;
+	if(rom->prgRAMEnabled && addr >= 0x6000 && addr < 0x8000) {
+		ram->prgRAM[addr - 0x6000] = byte;
 		return;
 	} else if(addr >= 0x6000) {
-		romWriteByte(addr, byte);
+		rom->romWriteByte(addr, byte);
 		return;
 	} else if(addr < 0x800) {
-		cpuRAM[addr] = byte;
+		ram->cpuRAM[addr] = byte;
 		return;
 	}
+	if(addr >= 0x4000 && addr <= 0x4017) {
+		apuOutputChanged();
+	}
 	switch(addr) {
 		case 0x2000:
-			ppuDataBus = byte;
+			ram->ppuDataBus = byte;
 			//printf("%04X %i %02X\n", cpu.pc, ppu.currentPixel / 340, byte);
-			if(byte & PPU_CTRL_ENABLE_VBLANK && (ppu.control & PPU_CTRL_ENABLE_VBLANK) == 0 && ppu.status & PPU_STATUS_VBLANK) {
-				ppu.nmiHappened = 0;
+			if(byte & PPU_CTRL_ENABLE_VBLANK && (ppu->control & PPU_CTRL_ENABLE_VBLANK) == 0 && ppu->status & PPU_STATUS_VBLANK) {
+				ppu->nmiHappened = 0;
 			}
 
-			ppu.control = byte;
-			ppu.t &= ~0xC00;
-			ppu.t |= (byte & 3) << 10;
+			ppu->control = byte;
+			ppu->t &= ~0xC00;
+			ppu->t |= (byte & 3) << 10;
 			break;
 		case 0x2001:
-			ppuDataBus = byte;
-			ppu.mask = byte;
+			ram->ppuDataBus = byte;
+			ppuMaskWrite(byte);
 			break;
 		case 0x2002:
 			// read only
-			ppuDataBus = byte;
+			ram->ppuDataBus = byte;
 			break;
 		case 0x2003:
-			ppuDataBus = byte;
-			ppu.oamAddr = byte;
+			ram->ppuDataBus = byte;
+			ppu->oamAddr = byte;
 			break;
 		case 0x2004:
-			ppuDataBus = byte;
-			ppu.oam[ppu.oamAddr] = byte;
-			++ppu.oamAddr;
+			ram->ppuDataBus = byte;
+			ppuOAMWrite(ppu->oamAddr, byte);
+			++ppu->oamAddr;
 			break;
 		case 0x2006:
-			ppuDataBus = byte;
+			ram->ppuDataBus = byte;
 			//*((uint8_t*)&ppu.vramAddr + (1 - ppu.w)) = byte;
-			if(!ppu.w) {
-				ppu.t &= ~0xFF00;
-				ppu.t |= (byte & 0x3F) << 8;
+			if(!ppu->w) {
+				ppu->t &= ~0xFF00;
+				ppu->t |= (byte & 0x3F) << 8;
 			} else {
-				ppu.t &= 0xFF00;
-				ppu.t |= byte;
-				ppu.vramAddr = ppu.t;
+				ppu->t &= 0xFF00;
+				ppu->t |= byte;
+				ppu->vramAddr = ppu->t;
 			}
 			#ifdef DEBUG
-				printf("ppu addr set to %04X\n", ppu.vramAddr);
+				printf("ppu addr set to %04X\n", ppu->vramAddr);
 			#endif
-			ppu.w = !ppu.w;
+			ppu->w = !ppu->w;
 			break;
 		case 0x2007:
-			ppuDataBus = byte;
+			ram->ppuDataBus = byte;
 			#ifdef DEBUG
-				printf("writing %02X into ppu %04X\n", byte, ppu.vramAddr);
+				printf("writing %02X into ppu %04X\n", byte, ppu->vramAddr);
 			#endif
-			ppuRAMWrite(ppu.vramAddr % 0x4000, byte);
-			ppu.vramAddr += (ppu.control & 0x04 ? 32 : 1);
+			ppuRAMWrite(ppu->vramAddr % 0x4000, byte);
+			ppu->vramAddr += (ppu->control & 0x04 ? 32 : 1);
 			break;
 		case 0x4014:
-			ppuDataBus = byte;
+			ram->ppuDataBus = byte;
 			oamDMAStart(byte);
 			break;
 			/*{
 				for(uint16_t i = 0; i < 256; ++i) {
 					// could potentially do wacky stuff if it gets into the apu/ppu register areas
-					ppu.oam[i] = ramReadByte((byte << 8) + i);
+					ppu->oam[i] = ramReadByte((byte << 8) + i);
 				}
 			}
 			break;*/
 		case 0x4016:
-			controllerLatch = byte & 0x01;
-			if(controllerLatch) {
-				controllers[0].shiftRegister = controllers[0].buttons;
-				controllers[1].shiftRegister = controllers[1].buttons;
+			input->controllerLatch = byte & 0x01;
+			if(input->controllerLatch) {
+				input->controllers[0].shiftRegister = input->controllers[0].buttons;
+				input->controllers[1].shiftRegister = input->controllers[1].buttons;
 			}
 			break;
 		case 0x2005:
-			ppuDataBus = byte;
-			if(!ppu.w) {
+			ram->ppuDataBus = byte;
+			if(!ppu->w) {
 				//printf("SCROLLX %02X\n", byte);
-				ppu.t &= ~0x1F;
-				ppu.t |= byte >> 3;
-				ppu.x = byte & 0x7;
+				ppu->t &= ~0x1F;
+				ppu->t |= byte >> 3;
+				ppu->x = byte & 0x7;
 			} else {
-				ppu.t &= ~0x3E0;
-				ppu.t |= (byte & 0xF8) << 2;
-				ppu.t &= ~0x7000;
-				ppu.t |= (byte & 0x7) << 12;
+				ppu->t &= ~0x3E0;
+				ppu->t |= (byte & 0xF8) << 2;
+				ppu->t &= ~0x7000;
+				ppu->t |= (byte & 0x7) << 12;
 			}
-			ppu.w = !ppu.w;
+			ppu->w = !ppu->w;
 			break;
 		case 0x4000: 
 		case 0x4004: {
@@ -226,44 +325,45 @@ void ramWriteByte(uint16_t addr, uint8_t byte) {
 	}
 }
 
-uint8_t ramReadByte(uint16_t addr) {
+uint8_t ramReadHandler(uint16_t addr) {
+	schedulerAccess();
 	addr = addrMap(addr);
-	if(rom.prgRAMEnabled && addr >= 0x6000 && addr < 0x8000) {
-		ramDataBus = prgRAM[addr - 0x6000];;
+	if(rom->prgRAMEnabled && addr >= 0x6000 && addr < 0x8000) {
+		ram->dataBus = ram->prgRAM[addr - 0x6000];;
 	} else if(addr >= 0x6000) {
-		ramDataBus = romReadByte(addr);
+		ram->dataBus = rom->romReadByte(addr);
 	} else if(addr < 0x800) {
-		ramDataBus = cpuRAM[addr];
+		ram->dataBus = ram->cpuRAM[addr];
 	} else {
 		switch(addr) {
 			case 0x2002:
 				{
 					// clear vblank flag after it's read
-					uint8_t tmp = ppu.status | (ppuDataBus & 0x1F);
-					ppuDataBus |= ppu.status & 0xE0;
-					ppu.status &= ~PPU_STATUS_VBLANK;
-					ppu.w = 0;
-					ramDataBus = tmp;
-					ppuDataBus &= 0x1F;
+					uint8_t tmp = ppu->status | (ram->ppuDataBus & 0x1F);
+					ram->ppuDataBus |= ppu->status & 0xE0;
+					ppu->status &= ~PPU_STATUS_VBLANK;
+					ppu->w = 0;
+					ram->dataBus = tmp;
+					ram->ppuDataBus &= 0x1F;
 					break;
 				}
 			case 0x2007: {
 				// https://www.nesdev.org/wiki/PPU_registers#The_PPUDATA_read_buffer
-				uint8_t v = ppu.readBuffer;
-				ppuDataBus = ppu.readBuffer;
+				uint8_t v = ppu->readBuffer;
+				ram->ppuDataBus = ppu->readBuffer;
 				// blindly trusting accuracycoin here, I think this is dependant on what revision of the ppu you have
-				if(ppu.vramAddr < 0x3f00) {
-					ppu.readBuffer = ppuRAMRead(ppu.vramAddr);
+				if(ppu->vramAddr < 0x3f00) {
+					ppu->readBuffer = ppuRAMRead(ppu->vramAddr);
 				} else {
-					v = ppuRAMRead(ppu.vramAddr);
-					ppu.readBuffer = ppuRAMRead(ppu.vramAddr - 0x1000);
+					v = ppuRAMRead(ppu->vramAddr);
+					ppu->readBuffer = ppuRAMRead(ppu->vramAddr - 0x1000);
 				}
-				if(ppu.control & 0x4) {
-					ppu.vramAddr += 32;
+				if(ppu->control & 0x4) {
+					ppu->vramAddr += 32;
 				} else {
-					ppu.vramAddr += 1;
+					ppu->vramAddr += 1;
 				}
-				ramDataBus = v;
+				ram->dataBus = v;
 				break;
 			}
 			case 0x2004:
@@ -273,7 +373,7 @@ uint8_t ramReadByte(uint16_t addr) {
 			case 0x2005:
 			case 0x2006:
 			case 0x4014:
-				ramDataBus = ppuDataBus;
+				ram->dataBus = ram->ppuDataBus;
 				break;
 			case 0x4000:
 			case 0x4001:
@@ -295,14 +395,14 @@ uint8_t ramReadByte(uint16_t addr) {
 				break;
 			case 0x4015:
 				// does not update the data bus
-				return apuGetStatus() | (ramDataBus & 0x20);
+				return apuGetStatus() | (ram->dataBus & 0x20);
 			case 0x4016:
-				ramDataBus &= 0xE0;
-				ramDataBus |= pollController(0) & 0x1F;
+				ram->dataBus &= 0xE0;
+				ram->dataBus |= pollController(0) & 0x1F;
 				break;
 			case 0x4017:
-				ramDataBus &= 0xE0;
-				ramDataBus |= pollController(1) & 0x1F;
+				ram->dataBus &= 0xE0;
+				ram->dataBus |= pollController(1) & 0x1F;
 				break;
 			default:
 				// open bus
@@ -310,5 +410,5 @@ uint8_t ramReadByte(uint16_t addr) {
 				break;
 		}
 	}
-	return ramDataBus;
+	return ram->dataBus;
 }
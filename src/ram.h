@@ -2,11 +2,76 @@
 #define RAM_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "cpu.h"
 
 #define ADDR16(addr) (uint16_t)((uint16_t)ramReadByte(addr) | (uint16_t)((ramReadByte(addr+1))<<8))
 
+// https://www.nesdev.org/wiki/CPU_memory_map
+// the cpu address space split into 256 byte pages
+// pages pointing straight at ram or the currently banked prg rom are accessed directly,
+// NULL pages (registers, mapper writes, open bus) go through ramReadHandler/ramWriteHandler
+// every byte in a code region gets a decoded instruction, indexed the same as the memory
+typedef struct {
+	uint8_t* memory;
+	size_t size;
+	cpuDecoded_t* code;
+} codeRegion_t;
+
+#define MAX_CODE_REGIONS 4
+
+typedef struct {
+	uint8_t* readPages[256];
+	uint8_t* writePages[256];
+
+	// decoded instructions for whatever is mapped into each read page, NULL if code there can't be cached
+	// ram pages with decoded code in them lose their write page until they get written to, which throws the code out
+	cpuDecoded_t* codePages[256];
+
+	uint8_t dataBus;
+	uint8_t ppuDataBus;
+
+	uint8_t cpuRAM[0x800];
+	uint8_t prgRAM[0x2000];
+
+	codeRegion_t codeRegions[MAX_CODE_REGIONS];
+	uint8_t codeRegionCount;
+	// write pages taken away by ramProtectCode
+	uint8_t* protectedPages[256];
+} ram_t;
+
+extern __thread ram_t* ram;
+
+void ramInit(void);
+void ramUninit(void);
+// memory has to be added here before it gets mapped for code in it to be cached
+void ramAddCodeRegion(uint8_t* memory, size_t size);
+void ramProtectCode(uint16_t addr);
+void ramMapReadPages(uint16_t addr, uint32_t size, uint8_t* memory);
+void ramMapWritePages(uint16_t addr, uint32_t size, uint8_t* memory);
+
 // ram writing functions to do specific things for like ppu registers and whatever
-void ramWriteByte(uint16_t addr, uint8_t byte);
-uint8_t ramReadByte(uint16_t addr);
+void ramWriteHandler(uint16_t addr, uint8_t byte);
+uint8_t ramReadHandler(uint16_t addr);
+
+static inline void ramWriteByte(uint16_t addr, uint8_t byte) {
+	uint8_t* page = ram->writePages[addr >> 8];
+	ram->dataBus = byte;
+	if(page) {
+		page[addr & 0xFF] = byte;
+		return;
+	}
+	ramWriteHandler(addr, byte);
+}
+
+static inline uint8_t ramReadByte(uint16_t addr) {
+	uint8_t* page = ram->readPages[addr >> 8];
+	if(page) {
+		ram->dataBus = page[addr & 0xFF];
+		return ram->dataBus;
+	}
+	return ramReadHandler(addr);
+}
 
 #endif
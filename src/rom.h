@@ -4,13 +4,66 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// https://www.nesdev.org/wiki/MMC1
+typedef struct {
+	uint8_t shiftReg;
+	uint8_t control;
+	uint8_t chrBank0;
+	uint8_t chrBank1;
+	uint8_t prgBank;
+} mmc1_t;
+
+typedef struct {
+	uint8_t bankSelect;
+	uint8_t prgRamWriteProtect;
+	uint8_t prgRamEnable;
+	uint8_t r[8];
+	uint8_t irqEnable;
+	uint8_t irqCounter;
+	uint8_t irqReload;
+	uint8_t irqReloadValue;
+	uint8_t ppuA12Prev;
+	uint8_t irqSignal;
+} mmc3_t;
+
+// https://www.nesdev.org/wiki/Sunsoft_FME-7#Banks
+typedef struct {
+	uint8_t command;
+	uint8_t chrBanks[8];
+	uint8_t prgBanks[4];
+	uint8_t mirroring;
+	uint8_t irqEnable;
+	uint8_t irqCounterEnable;
+	uint16_t irqCounter;
+	uint8_t irqSignal;
+
+	uint8_t audioRegister;
+	struct {
+		uint16_t timerPeriod;
+		uint16_t timer;
+		uint8_t volume;
+		uint8_t output;
+	} pulseChannels[3];
+	uint8_t disabledChannels;
+	uint8_t cycles;
+} sunsoft5b_t;
+
+typedef struct {
+	uint8_t prgBank;
+	uint8_t chrBank[4];
+	uint8_t latch[2];
+} mmc2_t;
 
 typedef struct rom_t {
 	uint8_t* prgROM;
 	uint8_t* chrROM;
 	size_t prgSize;
 	size_t chrSize;
+	// how much memory rom.chrROM points to, the same as chrSize unless it's chr ram
+	size_t chrMemSize;
 	uint8_t prgRAMEnabled;
+	// reading chr switches banks (mmc2), so the ppu has to do its reads in order one dot at a time
+	uint8_t chrLatch;
 
 	uint8_t isNSF;
 	uint16_t nsfLoadAddr;
@@ -20,23 +73,41 @@ typedef struct rom_t {
 	char nsfSongName[32];
 	char nsfSongAuthor[32];
 	char nsfSongCopyright[32];
-} rom_t;
 
-extern rom_t rom;
+	// probably should get better names for these that aren't so similar to the ram functions
+	void (*romWriteByte)(uint16_t addr, uint8_t byte);
+	uint8_t (*romReadByte)(uint16_t addr);
 
-void setNSFMapper(uint8_t* banks, uint8_t audioExpansion);
-void setMapper(uint16_t id);
+	void (*chrWriteByte)(uint16_t addr, uint8_t byte);
+	// reads go through ppu.patternBanks, this only gets called on the reads that flip mmc2's latches
+	void (*chrLatchRead)(uint16_t addr);
 
-// probably should get better names for these that aren't so similar to the ram functions
-extern void (*romWriteByte)(uint16_t addr, uint8_t byte);
-extern uint8_t (*romReadByte)(uint16_t addr);
+	void (*scanlineCounter)(void);
+	void (*cycleCounter)(void);
+	// how many cpu cycles from now the mapper could start asserting its irq, 0 if it's asserting it right now
+	uint32_t (*mapperCyclesUntilIRQ)(void);
 
-extern void (*chrWriteByte)(uint16_t addr, uint8_t byte);
-extern uint8_t (*chrReadByte)(uint16_t addr);
+	float (*expandedAudioGetSample)(void);
 
-extern void (*scanlineCounter)(void);
-extern void (*cycleCounter)(void);
+	mmc1_t mmc1;
+	mmc2_t mmc2;
+	mmc3_t mmc3;
+	sunsoft5b_t sunsoft5b;
+	uint8_t unromBank;
+	uint8_t anromBank;
+	uint8_t nsfBanks[8];
+} rom_t;
+
+extern __thread rom_t* rom;
+
+// what gets said about a rom while it's loaded, libnesemu keeps quiet since stdout belongs to the program using it
+#ifdef LIB
+	#define romLog(...) ((void)0)
+#else
+	#define romLog(...) printf(__VA_ARGS__)
+#endif
 
-extern float (*expandedAudioGetSample)(void);
+void setNSFMapper(const uint8_t* banks, uint8_t audioExpansion);
+uint8_t setMapper(uint16_t id);
 
 #endif
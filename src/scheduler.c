@@ -0,0 +1,99 @@
+#include "scheduler.h"
+
+#include "cpu.h"
+#include "ram.h"
+#include "rom.h"
+#include "ppu.h"
+#include "apu.h"
+#include "dma.h"
+
+__thread scheduler_t* scheduler;
+
+void schedulerInit(void) {
+	for(uint8_t i = 0; i < EVENT_COUNT; ++i) {
+		scheduler->queue[i] = i;
+		scheduler->queuePos[i] = i;
+		scheduler->eventTimes[i] = 0;
+	}
+	scheduler->cpuTime = 0;
+	scheduler->syncTime = 0;
+	schedulerStopAt(UINT64_MAX);
+	scheduler->next = 0;
+}
+
+void schedulerSwap(uint8_t a, uint8_t b) {
+	uint8_t tmp = scheduler->queue[a];
+	scheduler->queue[a] = scheduler->queue[b];
+	scheduler->queue[b] = tmp;
+	scheduler->queuePos[scheduler->queue[a]] = a;
+	scheduler->queuePos[scheduler->queue[b]] = b;
+}
+
+uint64_t schedulerTimeAt(uint8_t i) {
+	return scheduler->eventTimes[scheduler->queue[i]];
+}
+
+void schedulerSetEvent(uint8_t event, uint64_t time) {
+	uint8_t i = scheduler->queuePos[event];
+	scheduler->eventTimes[event] = time;
+	while(i > 0 && schedulerTimeAt((i - 1) / 2) > time) {
+		schedulerSwap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+	while(1) {
+		uint8_t smallest = i;
+		uint8_t left = i*2 + 1;
+		uint8_t right = i*2 + 2;
+		if(left < EVENT_COUNT && schedulerTimeAt(left) < schedulerTimeAt(smallest)) {
+			smallest = left;
+		}
+		if(right < EVENT_COUNT && schedulerTimeAt(right) < schedulerTimeAt(smallest)) {
+			smallest = right;
+		}
+		if(smallest == i) {
+			break;
+		}
+		schedulerSwap(i, smallest);
+		i = smallest;
+	}
+	scheduler->next = schedulerTimeAt(0);
+}
+
+void schedulerStopAt(uint64_t time) {
+	scheduler->stopTime = time;
+	// nesMain() only syncs once cpuTime is past an event, so this one goes a cycle early
+	// to stop on the first instruction boundary at or after time instead of one instruction later
+	schedulerSetEvent(EVENT_STOP, (time == 0 || time == UINT64_MAX) ? time : time - 1);
+}
+
+uint64_t schedulerIn(uint32_t cycles) {
+	return cycles == UINT32_MAX ? UINT64_MAX : scheduler->syncTime + cycles;
+}
+
+void schedulerSync(void) {
+	if(scheduler->syncing) {
+		return;
+	}
+	scheduler->syncing = 1;
+	// the dmc's sample fetches go over the bus, which the cpu could be in the middle of using
+	uint8_t dataBus = ram->dataBus;
+	// the ppu and everything clocked by the cpu don't affect each other in between syncs, so they can run one after the other
+	if(ppuRunUntil(scheduler->cpuTime) || scheduler->cpuTime >= scheduler->stopTime) {
+		scheduler->quit = 1;
+	}
+	for(; scheduler->syncTime < scheduler->cpuTime; ++scheduler->syncTime) {
+		dma->cycle = !dma->cycle;
+		rom->cycleCounter();
+		apuStep();
+	}
+	ram->dataBus = dataBus;
+	scheduler->syncing = 0;
+
+	uint32_t vblank = ppuDotsUntil(241*341 + 1) / 3;
+	uint32_t nmi = ppuCyclesUntilNMI();
+	schedulerSetEvent(EVENT_VBLANK, schedulerIn(nmi < vblank ? nmi : vblank));
+	schedulerSetEvent(EVENT_FRAME_IRQ, schedulerIn(apuCyclesUntilFrameIRQ()));
+	schedulerSetEvent(EVENT_DMC, schedulerIn(apuCyclesUntilDMCFetch()));
+	schedulerSetEvent(EVENT_MAPPER_IRQ, schedulerIn(rom->mapperCyclesUntilIRQ()));
+	scheduler->irqHeld = apuIRQAsserted();
+}
@@ -0,0 +1,60 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// https://www.nesdev.org/wiki/Catch-up
+// the cpu runs on its own and the ppu, apu and mapper only get caught up to it when the cpu could tell the difference:
+// when it goes through ramReadHandler/ramWriteHandler, or once the time of the earliest event below has passed
+// events are the only things the catch up does that change cpu.irq or cpu.nmi, predicted as early as they could happen
+
+enum {
+	// start of vblank and the nmi, always scheduled so frames keep getting drawn and input keeps getting read
+	EVENT_VBLANK,
+	EVENT_FRAME_IRQ,
+	// dmc sample fetches, only while one could end the sample with an irq
+	EVENT_DMC,
+	// mmc3 scanline counter, sunsoft 5b cycle counter
+	EVENT_MAPPER_IRQ,
+	// schedulerStopAt(), UINT64_MAX when nothing asked to stop
+	EVENT_STOP,
+	EVENT_COUNT,
+};
+
+typedef struct {
+	// cpu cycles since power on at the start of the instruction the cpu is on
+	uint64_t cpuTime;
+	// how far everything else has been run
+	uint64_t syncTime;
+	// time of the earliest event, 0 if they need to be looked at again
+	uint64_t next;
+	// scheduler.quit gets set by the first sync at or after this
+	uint64_t stopTime;
+	uint64_t eventTimes[EVENT_COUNT];
+	// binary min heap of events by time
+	uint8_t queue[EVENT_COUNT];
+	uint8_t queuePos[EVENT_COUNT];
+	// apu irqs stay asserted until the cpu acknowledges them, cpuStep() has to see them on every instruction until then
+	uint8_t irqHeld;
+	uint8_t syncing;
+	uint8_t quit;
+} scheduler_t;
+
+extern __thread scheduler_t* scheduler;
+
+void schedulerInit(void);
+void schedulerSetEvent(uint8_t event, uint64_t time);
+// makes nesMain() return once the cpu gets to time, it can go a little past since instructions and dma don't get split up
+void schedulerStopAt(uint64_t time);
+// runs everything up to the start of the cpu's current instruction and reschedules the events
+void schedulerSync(void);
+
+// for register accesses, everything has to be caught up before and the events can change after
+static inline void schedulerAccess(void) {
+	if(!scheduler->syncing) {
+		schedulerSync();
+		scheduler->next = 0;
+	}
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "tiles.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rom.h"
+
+__thread tiles_t* tiles;
+
+void tilesInit(size_t chrSize) {
+	tiles->count = chrSize / 16;
+	tiles->data = malloc(tiles->count * TILE_SIZE);
+	tiles->decoded = calloc(tiles->count, 1);
+}
+
+void tilesUninit(void) {
+	free(tiles->data);
+	free(tiles->decoded);
+	tiles->count = 0;
+}
+
+void tilesDecode(uint32_t tile) {
+	uint8_t* data = &tiles->data[tile*TILE_SIZE];
+	for(uint8_t y = 0; y < 8; ++y) {
+		uint8_t bitplane1 = rom->chrROM[tile*16 + y];
+		uint8_t bitplane2 = rom->chrROM[tile*16 + 8 + y];
+		for(uint8_t x = 0; x < 8; ++x) {
+			uint8_t pixel = ((bitplane1 >> (7-x)) & 1) | (((bitplane2 >> (7-x)) & 1) << 1);
+			data[y*8 + x] = pixel;
+			data[64 + y*8 + 7 - x] = pixel;
+		}
+	}
+	tiles->decoded[tile] = 1;
+}
+
+// for banks that go past the end of chr memory, these don't get cached
+// the address wraps around the chr memory like mapCHR() does with bank offsets, so it never reads past the end of it
+uint8_t* tilesDecodeRow(uint32_t addr, uint8_t flip) {
+	uint8_t* row = tiles->row;
+	if(rom->chrMemSize == 0) {
+		memset(row, 0, sizeof(tiles->row));
+		return row;
+	}
+	uint8_t bitplane1 = rom->chrROM[addr % rom->chrMemSize];
+	uint8_t bitplane2 = rom->chrROM[(addr + 8) % rom->chrMemSize];
+	for(uint8_t x = 0; x < 8; ++x) {
+		row[flip ? 7 - x : x] = ((bitplane1 >> (7-x)) & 1) | (((bitplane2 >> (7-x)) & 1) << 1);
+	}
+	return row;
+}
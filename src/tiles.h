@@ -0,0 +1,47 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// https://www.nesdev.org/wiki/PPU_pattern_tables
+// chr memory decoded to a byte per pixel, each tile being its 8 rows of 8 pixels followed by the same rows flipped horizontally
+// tiles are indexed by where they are in rom.chrROM so switching banks doesn't affect them,
+// they get decoded the first time they're used and thrown out when chr ram gets written to
+
+#define TILE_SIZE 128
+
+typedef struct {
+	uint8_t* data;
+	uint8_t* decoded;
+	uint32_t count;
+	// rows from past the end of chr memory get decoded into here
+	uint8_t row[8];
+} tiles_t;
+
+extern __thread tiles_t* tiles;
+
+void tilesInit(size_t chrSize);
+void tilesUninit(void);
+void tilesDecode(uint32_t tile);
+uint8_t* tilesDecodeRow(uint32_t addr, uint8_t flip);
+
+static inline void tilesDirty(uint32_t addr) {
+	if((addr >> 4) < tiles->count) {
+		tiles->decoded[addr >> 4] = 0;
+	}
+}
+
+// the pixels of the row with its first bitplane at addr in rom.chrROM, flipped horizontally if flip is set
+static inline uint8_t* tilesGetRow(uint32_t addr, uint8_t flip) {
+	uint32_t tile = addr >> 4;
+	if(tile >= tiles->count) {
+		return tilesDecodeRow(addr, flip);
+	}
+	if(!tiles->decoded[tile]) {
+		tilesDecode(tile);
+	}
+	return &tiles->data[tile*TILE_SIZE + flip*64 + (addr & 7)*8];
+}
+
+#endif
@@ -0,0 +1,827 @@
+// for clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+#include "wide.h"
+
+#ifdef WIDE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <immintrin.h>
+
+#include "opcodes.h"
+#include "files.h"
+#include "headless.h"
+#include "pool.h"
+
+enum {
+	WIDE_MODE_IMP,
+	WIDE_MODE_IMM,
+	WIDE_MODE_REL,
+	WIDE_MODE_ZP0,
+	WIDE_MODE_ZPX,
+	WIDE_MODE_ZPY,
+	WIDE_MODE_ABS,
+	WIDE_MODE_ABX,
+	WIDE_MODE_ABY,
+	WIDE_MODE_ABYD,
+	WIDE_MODE_IZX,
+	WIDE_MODE_IZY,
+};
+
+#define WIDE_MODE_ENTRY(code, instr, mode, cycles, pageCycles) [code] = WIDE_MODE_##mode,
+static const uint8_t wideModes[256] = {
+	OPCODES(WIDE_MODE_ENTRY)
+};
+
+#define WIDE_INSTRUCTION_ENTRY(code, instr, mode, cycles, pageCycles) [code] = INSTR_##instr,
+static const uint8_t wideInstructions[256] = {
+	OPCODES(WIDE_INSTRUCTION_ENTRY)
+};
+
+#define WIDE_CYCLES_ENTRY(code, instr, mode, cycles, pageCycles) [code] = cycles,
+static const uint8_t wideCycles[256] = {
+	OPCODES(WIDE_CYCLES_ENTRY)
+};
+
+#define WIDE_PAGE_CYCLES_ENTRY(code, instr, mode, cycles, pageCycles) [code] = pageCycles,
+static const uint8_t widePageCycles[256] = {
+	OPCODES(WIDE_PAGE_CYCLES_ENTRY)
+};
+
+// the same as cpu.c's lengths
+static const uint8_t wideModeLengths[] = {
+	[WIDE_MODE_IMP] = 1, [WIDE_MODE_IMM] = 2, [WIDE_MODE_REL] = 2, [WIDE_MODE_ZP0] = 2, [WIDE_MODE_ZPX] = 2, [WIDE_MODE_ZPY] = 2,
+	[WIDE_MODE_ABS] = 3, [WIDE_MODE_ABX] = 3, [WIDE_MODE_ABY] = 3, [WIDE_MODE_ABYD] = 3, [WIDE_MODE_IZX] = 2, [WIDE_MODE_IZY] = 2,
+};
+
+// how many operand bytes get fetched with the opcode, the same as cpu.c's
+static const uint8_t wideModeFetches[] = {
+	[WIDE_MODE_IMP] = 0, [WIDE_MODE_IMM] = 0, [WIDE_MODE_REL] = 0, [WIDE_MODE_ZP0] = 1, [WIDE_MODE_ZPX] = 1, [WIDE_MODE_ZPY] = 1,
+	[WIDE_MODE_ABS] = 2, [WIDE_MODE_ABX] = 2, [WIDE_MODE_ABY] = 2, [WIDE_MODE_ABYD] = 2, [WIDE_MODE_IZX] = 1, [WIDE_MODE_IZY] = 1,
+};
+
+enum {
+	// goes through cpuStep() one lane at a time
+	WIDE_SOLO = 0,
+	WIDE_LDA, WIDE_LDX, WIDE_LDY, WIDE_STA, WIDE_STX, WIDE_STY,
+	WIDE_AND, WIDE_ORA, WIDE_EOR, WIDE_ADC, WIDE_SBC, WIDE_CMP, WIDE_CPX, WIDE_CPY, WIDE_BIT,
+	WIDE_INC, WIDE_DEC, WIDE_IGN,
+	WIDE_INX, WIDE_INY, WIDE_DEX, WIDE_DEY, WIDE_TAX, WIDE_TAY, WIDE_TXA, WIDE_TYA, WIDE_TSX, WIDE_TXS,
+	WIDE_CLC, WIDE_SEC, WIDE_CLV, WIDE_NOP,
+	WIDE_ASL_A, WIDE_LSR_A, WIDE_ROL_A, WIDE_ROR_A,
+	WIDE_BPL, WIDE_BMI, WIDE_BVC, WIDE_BVS, WIDE_BCC, WIDE_BCS, WIDE_BNE, WIDE_BEQ,
+	WIDE_JMP,
+};
+
+// everything here can't touch the stack, I or anything but memory, the rest of the instructions run one lane at a time
+static const uint8_t wideInstructionKinds[INSTR_COUNT] = {
+	[INSTR_LDA] = WIDE_LDA, [INSTR_LDX] = WIDE_LDX, [INSTR_LDY] = WIDE_LDY, [INSTR_STA] = WIDE_STA, [INSTR_STX] = WIDE_STX, [INSTR_STY] = WIDE_STY,
+	[INSTR_AND] = WIDE_AND, [INSTR_ORA] = WIDE_ORA, [INSTR_EOR] = WIDE_EOR, [INSTR_ADC] = WIDE_ADC, [INSTR_SBC] = WIDE_SBC,
+	[INSTR_CMP] = WIDE_CMP, [INSTR_CPX] = WIDE_CPX, [INSTR_CPY] = WIDE_CPY, [INSTR_BIT] = WIDE_BIT,
+	[INSTR_INC] = WIDE_INC, [INSTR_DEC] = WIDE_DEC, [INSTR_IGN] = WIDE_IGN,
+	[INSTR_INX] = WIDE_INX, [INSTR_INY] = WIDE_INY, [INSTR_DEX] = WIDE_DEX, [INSTR_DEY] = WIDE_DEY,
+	[INSTR_TAX] = WIDE_TAX, [INSTR_TAY] = WIDE_TAY, [INSTR_TXA] = WIDE_TXA, [INSTR_TYA] = WIDE_TYA, [INSTR_TSX] = WIDE_TSX, [INSTR_TXS] = WIDE_TXS,
+	[INSTR_CLC] = WIDE_CLC, [INSTR_SEC] = WIDE_SEC, [INSTR_CLV] = WIDE_CLV, [INSTR_NOP] = WIDE_NOP,
+	[INSTR_ASL_A] = WIDE_ASL_A, [INSTR_LSR_A] = WIDE_LSR_A, [INSTR_ROL_A] = WIDE_ROL_A, [INSTR_ROR_A] = WIDE_ROR_A,
+	[INSTR_BPL] = WIDE_BPL, [INSTR_BMI] = WIDE_BMI, [INSTR_BVC] = WIDE_BVC, [INSTR_BVS] = WIDE_BVS,
+	[INSTR_BCC] = WIDE_BCC, [INSTR_BCS] = WIDE_BCS, [INSTR_BNE] = WIDE_BNE, [INSTR_BEQ] = WIDE_BEQ,
+	[INSTR_JMP] = WIDE_JMP,
+};
+
+uint8_t wideKinds[256];
+
+void wideSelectKernels(void);
+
+void wideInit(void) {
+	for(uint16_t i = 0; i < 256; ++i) {
+		wideKinds[i] = wideInstructionKinds[wideInstructions[i]];
+		// nops with an abs,X operand still do the dummy read, there's not enough of them to be worth it
+		if(wideKinds[i] == WIDE_NOP && wideModes[i] == WIDE_MODE_ABX) {
+			wideKinds[i] = WIDE_SOLO;
+		}
+	}
+	wideSelectKernels();
+}
+
+// which lanes have pc equal to target, as a bit for each
+uint32_t wideMatchScalar(const uint16_t* pcs, uint16_t target) {
+	uint32_t mask = 0;
+	for(uint32_t i = 0; i < WIDE_MAX_LANES; ++i) {
+		mask |= (uint32_t)(pcs[i] == target) << i;
+	}
+	return mask;
+}
+
+// adds each lane's cycles to its time, and returns which lanes are past their next event now
+uint32_t wideAdvanceScalar(uint64_t* time, const uint64_t* next, const uint8_t* cycles) {
+	uint32_t late = 0;
+	for(uint32_t i = 0; i < WIDE_MAX_LANES; ++i) {
+		time[i] += cycles[i];
+		late |= (uint32_t)(time[i] > next[i]) << i;
+	}
+	return late;
+}
+
+__attribute__((target("avx2")))
+uint32_t wideMatchAVX2(const uint16_t* pcs, uint16_t target) {
+	__m256i equal = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)pcs), _mm256_set1_epi16(target));
+	// packing down to bytes leaves one bit per lane for movemask
+	__m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(equal), _mm256_extracti128_si256(equal, 1));
+	return (uint16_t)_mm_movemask_epi8(packed);
+}
+
+// times stay far below 2^63 so the signed compare is fine
+__attribute__((target("avx2")))
+uint32_t wideAdvanceAVX2(uint64_t* time, const uint64_t* next, const uint8_t* cycles) {
+	uint32_t late = 0;
+	for(uint32_t i = 0; i < WIDE_MAX_LANES; i += 4) {
+		int32_t four;
+		memcpy(&four, &cycles[i], sizeof(four));
+		__m256i t = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)&time[i]), _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four)));
+		_mm256_storeu_si256((__m256i*)&time[i], t);
+		__m256i past = _mm256_cmpgt_epi64(t, _mm256_loadu_si256((const __m256i*)&next[i]));
+		late |= (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(past)) << i;
+	}
+	return late;
+}
+
+// avx-512 compares straight into a mask register
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+uint32_t wideMatchAVX512(const uint16_t* pcs, uint16_t target) {
+	return _mm256_cmpeq_epi16_mask(_mm256_loadu_si256((const __m256i*)pcs), _mm256_set1_epi16(target));
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+uint32_t wideAdvanceAVX512(uint64_t* time, const uint64_t* next, const uint8_t* cycles) {
+	uint32_t late = 0;
+	for(uint32_t i = 0; i < WIDE_MAX_LANES; i += 8) {
+		__m512i t = _mm512_add_epi64(_mm512_loadu_si512(&time[i]), _mm512_cvtepu8_epi64(_mm_loadl_epi64((const __m128i*)&cycles[i])));
+		_mm512_storeu_si512(&time[i], t);
+		late |= (uint32_t)_mm512_cmpgt_epu64_mask(t, _mm512_loadu_si512(&next[i])) << i;
+	}
+	return late;
+}
+
+uint32_t (*wideMatch)(const uint16_t* pcs, uint16_t target) = wideMatchScalar;
+uint32_t (*wideAdvance)(uint64_t* time, const uint64_t* next, const uint8_t* cycles) = wideAdvanceScalar;
+
+void wideSelectKernels(void) {
+	if(__builtin_cpu_supports("avx2")) {
+		wideMatch = wideMatchAVX2;
+		wideAdvance = wideAdvanceAVX2;
+	}
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+		wideMatch = wideMatchAVX512;
+		wideAdvance = wideAdvanceAVX512;
+	}
+}
+
+// the register file is 16 lanes of bytes, so it all fits in sse2 registers
+// lanes not in the group keep what they had
+static inline __m128i wideLanes(uint32_t mask) {
+	__m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	// multiplied unsigned, lanes 7 and 15 would overflow an int64_t
+	uint64_t high = (uint64_t)((mask >> 8) & 0xFF) * 0x0101010101010101;
+	uint64_t low = (uint64_t)(mask & 0xFF) * 0x0101010101010101;
+	__m128i spread = _mm_set_epi64x((int64_t)high, (int64_t)low);
+	return _mm_cmpeq_epi8(_mm_and_si128(spread, bits), bits);
+}
+
+static inline __m128i wideGet(const uint8_t* reg) {
+	return _mm_loadu_si128((const __m128i*)reg);
+}
+
+static inline void wideSet(uint8_t* reg, __m128i value, __m128i lanes) {
+	__m128i old = _mm_loadu_si128((const __m128i*)reg);
+	_mm_storeu_si128((__m128i*)reg, _mm_or_si128(_mm_and_si128(lanes, value), _mm_andnot_si128(lanes, old)));
+}
+
+static inline void wideSetNZ(wide_t* wide, __m128i value, __m128i lanes) {
+	wideSet(wide->nResult, value, lanes);
+	wideSet(wide->zResult, value, lanes);
+}
+
+// bit 7 of every byte as 0 or 1
+static inline __m128i wideBit7(__m128i value) {
+	return _mm_and_si128(_mm_srli_epi16(value, 7), _mm_set1_epi8(1));
+}
+
+// a full adder's carry out of bit 7 is the majority of both bit 7s and the carry into it, which is a^b^result
+static inline void wideADC(wide_t* wide, __m128i value, __m128i lanes) {
+	__m128i a = wideGet(wide->a);
+	__m128i carry = wideGet(wide->carry);
+	__m128i result = _mm_add_epi8(_mm_add_epi8(a, value), carry);
+	__m128i carryOut = _mm_or_si128(_mm_and_si128(a, value), _mm_andnot_si128(result, _mm_xor_si128(a, value)));
+	__m128i overflow = _mm_and_si128(_mm_and_si128(_mm_xor_si128(result, a), _mm_xor_si128(result, value)), _mm_set1_epi8(-128));
+	wideSet(wide->a, result, lanes);
+	wideSet(wide->carry, wideBit7(carryOut), lanes);
+	wideSet(wide->overflow, overflow, lanes);
+	wideSetNZ(wide, result, lanes);
+}
+
+static inline void wideCMP(wide_t* wide, __m128i reg, __m128i value, __m128i lanes) {
+	__m128i greaterEqual = _mm_cmpeq_epi8(_mm_max_epu8(reg, value), reg);
+	wideSet(wide->carry, _mm_and_si128(greaterEqual, _mm_set1_epi8(1)), lanes);
+	wideSetNZ(wide, _mm_sub_epi8(reg, value), lanes);
+}
+
+// copies lane i's console into the wide_t, and works out what it needs done before its next instruction
+static inline void wideLoadLane(wide_t* wide, uint32_t i) {
+	nes_t* nes = wide->lanes[i];
+	uint32_t bit = 1u << i;
+	wide->a[i] = nes->cpu.a;
+	wide->x[i] = nes->cpu.x;
+	wide->y[i] = nes->cpu.y;
+	wide->s[i] = nes->cpu.s;
+	wide->p[i] = nes->cpu.p;
+	wide->nResult[i] = nes->cpu.nResult;
+	wide->zResult[i] = nes->cpu.zResult;
+	wide->carry[i] = nes->cpu.carry;
+	wide->overflow[i] = nes->cpu.overflow;
+	wide->pc[i] = nes->cpu.pc;
+	wide->time[i] = nes->scheduler.cpuTime;
+	wide->next[i] = nes->scheduler.next;
+	wide->late = (wide->late & ~bit) | (wide->time[i] > wide->next[i] ? bit : 0);
+	wide->dmaActive = (wide->dmaActive & ~bit) | (nes->dma.active ? bit : 0);
+	wide->irqLow = (wide->irqLow & ~bit) | (nes->cpu.irq == 0 ? bit : 0);
+	// nesMain() pulls irq low before every instruction while the apu is holding it
+	uint8_t irq = !(nes->cpu.p & I_FLAG) && (nes->cpu.irq == 0 || nes->scheduler.irqHeld);
+	wide->pending = (wide->pending & ~bit) | (irq || nes->cpu.nmi == 0 ? bit : 0);
+}
+
+static inline void wideStoreLane(wide_t* wide, uint32_t i) {
+	nes_t* nes = wide->lanes[i];
+	nes->cpu.a = wide->a[i];
+	nes->cpu.x = wide->x[i];
+	nes->cpu.y = wide->y[i];
+	nes->cpu.s = wide->s[i];
+	nes->cpu.p = wide->p[i];
+	nes->cpu.nResult = wide->nResult[i];
+	nes->cpu.zResult = wide->zResult[i];
+	nes->cpu.carry = wide->carry[i];
+	nes->cpu.overflow = wide->overflow[i];
+	nes->cpu.pc = wide->pc[i];
+	nes->scheduler.cpuTime = wide->time[i];
+}
+
+// one instruction for lane i, the same as an iteration of nesMain() without the catching up at the start
+void wideStepLane(wide_t* wide, uint32_t i) {
+	nesBind(wide->lanes[i]);
+	wideStoreLane(wide, i);
+	if(scheduler->irqHeld) {
+		cpu->irq = 0;
+	}
+	cpuStep();
+	scheduler->cpuTime += cpu->cycles;
+	cpu->cycles = 0;
+	wideLoadLane(wide, i);
+	++wide->solo;
+}
+
+void wideStopAtFrame(void) {
+	scheduler->quit = 1;
+}
+
+wide_t* wideCreate(nes_t** lanes, uint32_t count) {
+	if(count == 0 || count > WIDE_MAX_LANES) {
+		return NULL;
+	}
+	wide_t* wide = calloc(1, sizeof(wide_t));
+	if(wide == NULL) {
+		return NULL;
+	}
+	wide->laneCount = count;
+	for(uint32_t i = 0; i < WIDE_MAX_LANES; ++i) {
+		wide->lanes[i] = i < count ? lanes[i] : NULL;
+		// lanes past the end never get late
+		wide->next[i] = UINT64_MAX;
+	}
+	return wide;
+}
+
+void wideDestroy(wide_t* wide) {
+	free(wide);
+}
+
+// works out the address of the instruction's operand for every lane in vector and reads it into values,
+// lanes where that would go through ramReadHandler/ramWriteHandler are taken out of vector
+// anything running the instruction leaves the data bus as the last thing it read or wrote, that gets done here too
+static uint32_t wideOperands(wide_t* wide, uint32_t vector, uint8_t mode, uint16_t operand, uint8_t write, uint8_t read, uint16_t* addrs, uint8_t* values, uint8_t* crossed) {
+	for(uint32_t lanes = vector; lanes; lanes &= lanes - 1) {
+		uint32_t i = __builtin_ctz(lanes);
+		ram_t* laneRAM = &wide->lanes[i]->ram;
+		uint16_t addr = operand;
+		uint16_t base = operand;
+		uint8_t dummy = 0;
+		crossed[i] = 0;
+		switch(mode) {
+			case WIDE_MODE_ZPX: addr = (operand + wide->x[i]) & 0xFF; break;
+			case WIDE_MODE_ZPY: addr = (operand + wide->y[i]) & 0xFF; break;
+			case WIDE_MODE_ABX:
+				addr = operand + wide->x[i];
+				crossed[i] = (operand >> 8) != (addr >> 8);
+				dummy = crossed[i];
+				break;
+			case WIDE_MODE_ABYD:
+				addr = operand + wide->y[i];
+				crossed[i] = (operand >> 8) != (addr >> 8);
+				dummy = crossed[i];
+				break;
+			case WIDE_MODE_ABY:
+				addr = operand + wide->y[i];
+				crossed[i] = (operand >> 8) != (addr >> 8);
+				break;
+			case WIDE_MODE_IZX: {
+				if(!laneRAM->readPages[0]) { vector &= ~(1u << i); continue; }
+				uint8_t zp = operand + wide->x[i];
+				addr = laneRAM->readPages[0][zp] | laneRAM->readPages[0][(zp + 1) & 0xFF] << 8;
+				break;
+			}
+			case WIDE_MODE_IZY:
+				if(!laneRAM->readPages[0]) { vector &= ~(1u << i); continue; }
+				base = laneRAM->readPages[0][operand & 0xFF] | laneRAM->readPages[0][(operand + 1) & 0xFF] << 8;
+				addr = base + wide->y[i];
+				crossed[i] = (base >> 8) != (addr >> 8);
+				break;
+		}
+		// the dummy read is in the page of the unfixed address
+		if((dummy && !laneRAM->readPages[base >> 8]) || (read && !laneRAM->readPages[addr >> 8]) || (write && !laneRAM->writePages[addr >> 8])) {
+			vector &= ~(1u << i);
+			continue;
+		}
+		addrs[i] = addr;
+		if(read) {
+			values[i] = laneRAM->readPages[addr >> 8][addr & 0xFF];
+			laneRAM->dataBus = values[i];
+		}
+	}
+	return vector;
+}
+
+// runs the instruction at the group's pc for the lanes in vector, returns the lanes it couldn't be run for
+static uint32_t wideRun(wide_t* wide, uint32_t vector, const uint8_t* code, uint8_t* cycles) {
+	uint8_t opcode = code[0];
+	uint8_t kind = wideKinds[opcode];
+	uint8_t mode = wideModes[opcode];
+	uint8_t length = wideModeLengths[mode];
+	uint16_t operand = length == 3 ? (code[1] | code[2] << 8) : code[1];
+	// immediate and relative operands aren't fetched with the instruction, they're read by it
+	uint8_t lastByte = code[wideModeFetches[mode]];
+
+	uint8_t stores = kind == WIDE_STA || kind == WIDE_STX || kind == WIDE_STY;
+	uint8_t modifies = kind == WIDE_INC || kind == WIDE_DEC;
+	uint8_t memory = mode >= WIDE_MODE_ZP0 && kind != WIDE_JMP && kind != WIDE_NOP;
+
+	uint16_t addrs[WIDE_MAX_LANES];
+	uint8_t values[WIDE_MAX_LANES];
+	uint8_t crossed[WIDE_MAX_LANES] = {0};
+	uint32_t all = vector;
+	// everything starts with the bus holding the last byte of the instruction like cpuStep() leaves it
+	for(uint32_t lanes = vector; lanes; lanes &= lanes - 1) {
+		wide->lanes[__builtin_ctz(lanes)]->ram.dataBus = lastByte;
+	}
+	if(memory) {
+		vector = wideOperands(wide, vector, mode, operand, stores || modifies, !stores, addrs, values, crossed);
+		if(!vector) {
+			return all;
+		}
+	} else if((mode == WIDE_MODE_IMM && kind != WIDE_NOP) || mode == WIDE_MODE_REL) {
+		memset(values, code[1], sizeof(values));
+		for(uint32_t bits = vector; bits; bits &= bits - 1) {
+			wide->lanes[__builtin_ctz(bits)]->ram.dataBus = code[1];
+		}
+	}
+
+	__m128i lanes = wideLanes(vector);
+	__m128i value = _mm_loadu_si128((const __m128i*)values);
+	switch(kind) {
+		case WIDE_LDA: wideSet(wide->a, value, lanes); wideSetNZ(wide, value, lanes); break;
+		case WIDE_LDX: wideSet(wide->x, value, lanes); wideSetNZ(wide, value, lanes); break;
+		case WIDE_LDY: wideSet(wide->y, value, lanes); wideSetNZ(wide, value, lanes); break;
+		case WIDE_AND: {
+			__m128i a = _mm_and_si128(wideGet(wide->a), value);
+			wideSet(wide->a, a, lanes);
+			wideSetNZ(wide, a, lanes);
+			break;
+		}
+		case WIDE_ORA: {
+			__m128i a = _mm_or_si128(wideGet(wide->a), value);
+			wideSet(wide->a, a, lanes);
+			wideSetNZ(wide, a, lanes);
+			break;
+		}
+		case WIDE_EOR: {
+			__m128i a = _mm_xor_si128(wideGet(wide->a), value);
+			wideSet(wide->a, a, lanes);
+			wideSetNZ(wide, a, lanes);
+			break;
+		}
+		case WIDE_ADC: wideADC(wide, value, lanes); break;
+		// a - b - !c is a + ~b + c, carry and overflow come out the same way too
+		case WIDE_SBC: wideADC(wide, _mm_xor_si128(value, _mm_set1_epi8(-1)), lanes); break;
+		case WIDE_CMP: wideCMP(wide, wideGet(wide->a), value, lanes); break;
+		case WIDE_CPX: wideCMP(wide, wideGet(wide->x), value, lanes); break;
+		case WIDE_CPY: wideCMP(wide, wideGet(wide->y), value, lanes); break;
+		case WIDE_BIT:
+			wideSet(wide->zResult, _mm_and_si128(value, wideGet(wide->a)), lanes);
+			wideSet(wide->overflow, _mm_and_si128(value, _mm_set1_epi8(V_FLAG)), lanes);
+			wideSet(wide->nResult, value, lanes);
+			break;
+		case WIDE_IGN: break;
+		case WIDE_STA:
+		case WIDE_STX:
+		case WIDE_STY: {
+			const uint8_t* reg = kind == WIDE_STA ? wide->a : (kind == WIDE_STX ? wide->x : wide->y);
+			for(uint32_t bits = vector; bits; bits &= bits - 1) {
+				uint32_t i = __builtin_ctz(bits);
+				ram_t* laneRAM = &wide->lanes[i]->ram;
+				laneRAM->writePages[addrs[i] >> 8][addrs[i] & 0xFF] = reg[i];
+				laneRAM->dataBus = reg[i];
+			}
+			break;
+		}
+		case WIDE_INC:
+		case WIDE_DEC: {
+			__m128i result = _mm_add_epi8(value, _mm_set1_epi8(kind == WIDE_INC ? 1 : -1));
+			_mm_storeu_si128((__m128i*)values, result);
+			for(uint32_t bits = vector; bits; bits &= bits - 1) {
+				uint32_t i = __builtin_ctz(bits);
+				ram_t* laneRAM = &wide->lanes[i]->ram;
+				laneRAM->writePages[addrs[i] >> 8][addrs[i] & 0xFF] = values[i];
+				laneRAM->dataBus = values[i];
+			}
+			wideSetNZ(wide, result, lanes);
+			break;
+		}
+		case WIDE_INX: {
+			__m128i x = _mm_add_epi8(wideGet(wide->x), _mm_set1_epi8(1));
+			wideSet(wide->x, x, lanes);
+			wideSetNZ(wide, x, lanes);
+			break;
+		}
+		case WIDE_INY: {
+			__m128i y = _mm_add_epi8(wideGet(wide->y), _mm_set1_epi8(1));
+			wideSet(wide->y, y, lanes);
+			wideSetNZ(wide, y, lanes);
+			break;
+		}
+		case WIDE_DEX: {
+			__m128i x = _mm_sub_epi8(wideGet(wide->x), _mm_set1_epi8(1));
+			wideSet(wide->x, x, lanes);
+			wideSetNZ(wide, x, lanes);
+			break;
+		}
+		case WIDE_DEY: {
+			__m128i y = _mm_sub_epi8(wideGet(wide->y), _mm_set1_epi8(1));
+			wideSet(wide->y, y, lanes);
+			wideSetNZ(wide, y, lanes);
+			break;
+		}
+		case WIDE_TAX: wideSet(wide->x, wideGet(wide->a), lanes); wideSetNZ(wide, wideGet(wide->a), lanes); break;
+		case WIDE_TAY: wideSet(wide->y, wideGet(wide->a), lanes); wideSetNZ(wide, wideGet(wide->a), lanes); break;
+		case WIDE_TXA: wideSet(wide->a, wideGet(wide->x), lanes); wideSetNZ(wide, wideGet(wide->x), lanes); break;
+		case WIDE_TYA: wideSet(wide->a, wideGet(wide->y), lanes); wideSetNZ(wide, wideGet(wide->y), lanes); break;
+		case WIDE_TSX: wideSet(wide->x, wideGet(wide->s), lanes); wideSetNZ(wide, wideGet(wide->s), lanes); break;
+		case WIDE_TXS: wideSet(wide->s, wideGet(wide->x), lanes); break;
+		case WIDE_CLC: wideSet(wide->carry, _mm_setzero_si128(), lanes); break;
+		case WIDE_SEC: wideSet(wide->carry, _mm_set1_epi8(1), lanes); break;
+		case WIDE_CLV: wideSet(wide->overflow, _mm_setzero_si128(), lanes); break;
+		case WIDE_NOP: break;
+		case WIDE_ASL_A: {
+			__m128i a = wideGet(wide->a);
+			__m128i result = _mm_add_epi8(a, a);
+			wideSet(wide->carry, wideBit7(a), lanes);
+			wideSet(wide->a, result, lanes);
+			wideSetNZ(wide, result, lanes);
+			break;
+		}
+		case WIDE_LSR_A: {
+			__m128i a = wideGet(wide->a);
+			__m128i result = _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7F));
+			wideSet(wide->carry, _mm_and_si128(a, _mm_set1_epi8(1)), lanes);
+			wideSet(wide->a, result, lanes);
+			wideSetNZ(wide, result, lanes);
+			break;
+		}
+		case WIDE_ROL_A: {
+			__m128i a = wideGet(wide->a);
+			__m128i result = _mm_or_si128(_mm_add_epi8(a, a), wideGet(wide->carry));
+			wideSet(wide->carry, wideBit7(a), lanes);
+			wideSet(wide->a, result, lanes);
+			wideSetNZ(wide, result, lanes);
+			break;
+		}
+		case WIDE_ROR_A: {
+			__m128i a = wideGet(wide->a);
+			__m128i result = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7F)), _mm_slli_epi16(wideGet(wide->carry), 7));
+			wideSet(wide->carry, _mm_and_si128(a, _mm_set1_epi8(1)), lanes);
+			wideSet(wide->a, result, lanes);
+			wideSetNZ(wide, result, lanes);
+			break;
+		}
+		case WIDE_JMP: break;
+	}
+
+	uint8_t base = wideCycles[opcode];
+	uint8_t pageCycles = widePageCycles[opcode];
+	uint32_t taken = 0;
+	if(kind >= WIDE_BPL && kind <= WIDE_BEQ) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i cond = zero;
+		switch(kind) {
+			case WIDE_BPL: case WIDE_BMI: cond = _mm_cmplt_epi8(wideGet(wide->nResult), zero); break;
+			case WIDE_BVC: case WIDE_BVS: cond = _mm_cmpeq_epi8(_mm_cmpeq_epi8(wideGet(wide->overflow), zero), zero); break;
+			case WIDE_BCC: case WIDE_BCS: cond = _mm_cmpeq_epi8(_mm_cmpeq_epi8(wideGet(wide->carry), zero), zero); break;
+			case WIDE_BNE: case WIDE_BEQ: cond = _mm_cmpeq_epi8(wideGet(wide->zResult), zero); break;
+		}
+		// the odd ones branch when the flag is set (or Z is set for BEQ), the even ones when it's clear
+		uint32_t set = (uint16_t)_mm_movemask_epi8(cond);
+		taken = ((kind - WIDE_BPL) & 1) ? set : ~set;
+		taken &= vector;
+	}
+
+	for(uint32_t bits = vector; bits; bits &= bits - 1) {
+		uint32_t i = __builtin_ctz(bits);
+		uint16_t pc = wide->pc[i] + length;
+		cycles[i] = base + (crossed[i] ? pageCycles : 0);
+		if(kind == WIDE_JMP) {
+			pc = operand;
+		} else if(taken & (1u << i)) {
+			uint16_t target = pc + (int8_t)code[1];
+			cycles[i] += 1 + ((target >> 8) != (pc >> 8));
+			pc = target;
+		}
+		wide->pc[i] = pc;
+	}
+	// cpuStep() puts irq back up after every instruction, lanes with an interrupt to take never get here
+	for(uint32_t bits = vector & wide->irqLow; bits; bits &= bits - 1) {
+		wide->lanes[__builtin_ctz(bits)]->cpu.irq = 1;
+	}
+	wide->irqLow &= ~vector;
+	wide->together += __builtin_popcount(vector);
+	return all & ~vector;
+}
+
+// the biggest group of lanes at the same pc, unless something's been left waiting too long
+// leader is the lane whose instruction bytes the group runs
+static uint32_t wideGroup(wide_t* wide, uint32_t eligible, uint32_t* leader) {
+	uint32_t oldest = __builtin_ctz(eligible);
+	for(uint32_t bits = eligible; bits; bits &= bits - 1) {
+		uint32_t i = __builtin_ctz(bits);
+		if(wide->waiting[i] > wide->waiting[oldest]) {
+			oldest = i;
+		}
+	}
+	if(wide->waiting[oldest] >= WIDE_MAX_WAIT) {
+		*leader = oldest;
+		return wideMatch(wide->pc, wide->pc[oldest]) & eligible;
+	}
+	uint32_t best = 0;
+	for(uint32_t left = eligible; left;) {
+		uint32_t group = wideMatch(wide->pc, wide->pc[__builtin_ctz(left)]) & eligible;
+		if(__builtin_popcount(group) > __builtin_popcount(best)) {
+			best = group;
+		}
+		left &= ~group;
+	}
+	*leader = __builtin_ctz(best);
+	return best;
+}
+
+void wideStepFrame(wide_t* wide) {
+	wide->running = (1u << wide->laneCount) - 1;
+	wide->diverged = 0;
+	for(uint32_t i = 0; i < wide->laneCount; ++i) {
+		nes_t* nes = wide->lanes[i];
+		nes->ppu.frameDone = wideStopAtFrame;
+		nes->apu.sampleCount = 0;
+		nes->scheduler.quit = 0;
+		// idle loops don't get tracked in here, it has to start over when a lane goes back to nesMain()
+		nes->idle.length = -1;
+		wide->waiting[i] = 0;
+		wide->alone[i] = 0;
+		wideLoadLane(wide, i);
+	}
+
+	uint8_t cycles[WIDE_MAX_LANES];
+	while(wide->running) {
+		// catching up and dma, the same as the start of nesMain()'s loop
+		uint32_t busy = 0;
+		for(uint32_t bits = (wide->late | wide->dmaActive) & wide->running; bits; bits &= bits - 1) {
+			uint32_t i = __builtin_ctz(bits);
+			nesBind(wide->lanes[i]);
+			wideStoreLane(wide, i);
+			schedulerSync();
+			if(scheduler->quit) {
+				wide->running &= ~(1u << i);
+			} else if(dma->active) {
+				dmaStep();
+				scheduler->cpuTime += cpu->cycles;
+				cpu->cycles = 0;
+				busy |= 1u << i;
+			}
+			wideLoadLane(wide, i);
+		}
+
+		uint32_t eligible = wide->running & ~busy;
+		if(!eligible) {
+			continue;
+		}
+		uint32_t leader;
+		uint32_t group = wideGroup(wide, eligible, &leader);
+		uint16_t pc = wide->pc[leader];
+		uint8_t* page = wide->lanes[leader]->ram.readPages[pc >> 8];
+
+		memset(cycles, 0, sizeof(cycles));
+		uint32_t solo = group;
+		if(page && wideKinds[page[pc & 0xFF]] != WIDE_SOLO) {
+			const uint8_t* code = &page[pc & 0xFF];
+			uint8_t length = wideModeLengths[wideModes[code[0]]];
+			if((pc & 0xFF) + length <= 0x100) {
+				// the same pc can have different banks mapped in, lanes with other bytes there wait for another group
+				for(uint32_t bits = group; bits; bits &= bits - 1) {
+					uint32_t i = __builtin_ctz(bits);
+					uint8_t* lanePage = wide->lanes[i]->ram.readPages[pc >> 8];
+					if(!lanePage || memcmp(&lanePage[pc & 0xFF], code, length) != 0) {
+						group &= ~(1u << i);
+					}
+				}
+				solo = wideRun(wide, group & ~wide->pending, code, cycles) | (group & wide->pending);
+			}
+		}
+		for(uint32_t bits = solo; bits; bits &= bits - 1) {
+			wideStepLane(wide, __builtin_ctz(bits));
+		}
+		// the lanes that went one at a time already have their time and late bit from wideLoadLane()
+		uint32_t solved = wideAdvance(wide->time, wide->next, cycles);
+		uint32_t vectored = group & ~solo;
+		wide->late = (wide->late & ~vectored) | (solved & vectored);
+
+		for(uint32_t bits = eligible; bits; bits &= bits - 1) {
+			uint32_t i = __builtin_ctz(bits);
+			if(!(group & (1u << i))) {
+				if(wide->waiting[i] < UINT8_MAX) {
+					++wide->waiting[i];
+				}
+				continue;
+			}
+			wide->waiting[i] = 0;
+			wide->alone[i] = __builtin_popcount(group) == 1 ? wide->alone[i] + 1 : 0;
+			if(wide->alone[i] > WIDE_DIVERGE_LIMIT) {
+				wide->running &= ~(1u << i);
+				wide->diverged |= 1u << i;
+			}
+		}
+	}
+
+	for(uint32_t i = 0; i < wide->laneCount; ++i) {
+		wideStoreLane(wide, i);
+	}
+	// lanes that went off on their own finish the frame the normal way
+	for(uint32_t bits = wide->diverged; bits; bits &= bits - 1) {
+		nesBind(wide->lanes[__builtin_ctz(bits)]);
+		nesMain();
+		++wide->fallbacks;
+	}
+	nesBind(NULL);
+}
+
+// buttons for a lane on a frame, they change every 8 frames
+// with spread each lane gets its own so they drift apart, otherwise they all press the same ones
+uint8_t wideBenchButtons(uint32_t lane, uint32_t frame, uint8_t spread) {
+	uint32_t hash = (spread ? lane + 1 : 0) * 0x9E3779B1u ^ (frame / 8 + 1) * 0x85EBCA77u;
+	hash ^= hash >> 15;
+	hash *= 0x2C1B3C6Du;
+	hash ^= hash >> 12;
+	// no start or select, they mostly just pause
+	return hash & 0xF3;
+}
+
+nes_t* wideBenchConsole(const uint8_t* data, long size) {
+	nes_t* nes = nesCreate();
+	if(nes == NULL) {
+		return NULL;
+	}
+	if(loadROMFromMemory(data, size) != 0 || rom->isNSF) {
+		nesDestroy(nes);
+		return NULL;
+	}
+	ramInit();
+	cpuInit();
+	schedulerInit();
+	nesBind(NULL);
+	return nes;
+}
+
+typedef struct {
+	nes_t** consoles;
+	uint32_t frames;
+	uint8_t spread;
+} wideBench_t;
+
+void wideBenchTask(void* data, uint32_t index) {
+	wideBench_t* bench = data;
+	nesBind(bench->consoles[index]);
+	ppu->frameDone = wideStopAtFrame;
+	for(uint32_t frame = 0; frame < bench->frames; ++frame) {
+		input->controllers[0].buttons = wideBenchButtons(index, frame, bench->spread);
+		apu->sampleCount = 0;
+		scheduler->quit = 0;
+		nesMain();
+	}
+	nesBind(NULL);
+}
+
+// cpu time used by every thread, so frames for each second of it is frames a second per core
+double wideCPUSeconds(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+uint8_t wideBenchmark(const char* path, uint32_t lanes, uint32_t frames) {
+	if(lanes == 0 || lanes > WIDE_MAX_LANES) {
+		printf("the wide core runs 1 to %d lanes\n", WIDE_MAX_LANES);
+		return 1;
+	}
+	long size;
+	uint8_t* data = headlessReadFile(path, &size);
+	if(data == NULL) {
+		return 1;
+	}
+	pool_t* pool = poolCreate(lanes);
+	if(pool == NULL) {
+		printf("could not start the benchmark threads\n");
+		free(data);
+		return 1;
+	}
+
+	uint8_t ret = 0;
+	for(uint8_t spread = 0; spread < 2 && ret == 0; ++spread) {
+		nes_t* scalar[WIDE_MAX_LANES] = {0};
+		nes_t* wideLanes[WIDE_MAX_LANES] = {0};
+		for(uint32_t i = 0; i < lanes; ++i) {
+			scalar[i] = wideBenchConsole(data, size);
+			wideLanes[i] = wideBenchConsole(data, size);
+			if(scalar[i] == NULL || wideLanes[i] == NULL) {
+				printf("could not load %s\n", path);
+				ret = 1;
+			}
+		}
+		wide_t* wide = ret ? NULL : wideCreate(wideLanes, lanes);
+
+		if(wide) {
+			// a thread for each console like running them with nesemuStepBatch() would
+			wideBench_t bench;
+			bench.consoles = scalar;
+			bench.frames = frames;
+			bench.spread = spread;
+			double start = wideCPUSeconds();
+			poolRun(pool, wideBenchTask, &bench, lanes);
+			double scalarSeconds = wideCPUSeconds() - start;
+
+			start = wideCPUSeconds();
+			for(uint32_t frame = 0; frame < frames; ++frame) {
+				for(uint32_t i = 0; i < lanes; ++i) {
+					wideLanes[i]->input.controllers[0].buttons = wideBenchButtons(i, frame, spread);
+				}
+				wideStepFrame(wide);
+			}
+			double wideSeconds = wideCPUSeconds() - start;
+
+			uint32_t differ = 0;
+			for(uint32_t i = 0; i < lanes; ++i) {
+				nes_t* a = scalar[i];
+				nes_t* b = wideLanes[i];
+				if(memcmp(a->frame.pixels, b->frame.pixels, sizeof(a->frame.pixels)) != 0 || memcmp(a->ram.cpuRAM, b->ram.cpuRAM, sizeof(a->ram.cpuRAM)) != 0
+					|| a->scheduler.cpuTime != b->scheduler.cpuTime || a->cpu.pc != b->cpu.pc || a->cpu.a != b->cpu.a || a->cpu.x != b->cpu.x || a->cpu.y != b->cpu.y || a->cpu.s != b->cpu.s) {
+					++differ;
+				}
+			}
+			double scalarFPS = lanes * frames / scalarSeconds;
+			double wideFPS = lanes * frames / wideSeconds;
+			printf("%s: %u lanes, %u frames\n", spread ? "different input per lane" : "same input on every lane", lanes, frames);
+			printf("  scalar threads: %.0f frames a second per core\n", scalarFPS);
+			printf("  wide core:      %.0f frames a second per core (%.2fx)\n", wideFPS, wideFPS / scalarFPS);
+			printf("  %.1f%% of what the wide core ran was run together, %lu lane frames finished by nesMain(), %u lanes differ from the scalar run\n",
+				100.0 * wide->together / (wide->together + wide->solo), (unsigned long)wide->fallbacks, differ);
+			if(differ) {
+				ret = 1;
+			}
+		}
+
+		wideDestroy(wide);
+		for(uint32_t i = 0; i < lanes; ++i) {
+			if(scalar[i]) { nesDestroy(scalar[i]); }
+			if(wideLanes[i]) { nesDestroy(wideLanes[i]); }
+		}
+	}
+
+	poolDestroy(pool);
+	free(data);
+	return ret;
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef WIDE_H
+#define WIDE_H
+
+#include <stdint.h>
+
+#include "nes.h"
+
+// experimental lockstep core for running up to 16 consoles with the same rom at once, built with -DWIDE
+// every lane is a whole console with its own ppu, apu, mapper and scheduler, only the cpu gets run together
+// each step the lanes at the same pc running the same instruction bytes make a group, and if it's one of the common
+// instructions that only touch registers and memory mapped straight to ram or rom it runs for all of them at once
+// on a structure of arrays copy of their registers, with the lanes that aren't in the group masked off
+// anything else (registers, stack, interrupts, dma) gets run by cpuStep() one lane at a time
+// a lane that keeps running on its own because it went somewhere the others didn't finishes the frame with nesMain()
+
+#ifdef WIDE
+
+#if !defined(__x86_64__)
+#error "the wide core only supports x86-64"
+#endif
+
+#define WIDE_MAX_LANES 16
+// a lane that runs this many instructions in a row in a group by itself leaves the others for the rest of the frame
+#define WIDE_DIVERGE_LIMIT 64
+// a lane left out of this many groups in a row gets its pc picked next even if more lanes are somewhere else
+#define WIDE_MAX_WAIT 4
+
+typedef struct {
+	// the registers of every lane, with the flags kept the same way cpu_t keeps them
+	// during wideStepFrame() these are the real ones and a console's cpu_t only gets them around what it runs on its own
+	uint8_t a[WIDE_MAX_LANES];
+	uint8_t x[WIDE_MAX_LANES];
+	uint8_t y[WIDE_MAX_LANES];
+	uint8_t s[WIDE_MAX_LANES];
+	uint8_t p[WIDE_MAX_LANES];
+	uint8_t nResult[WIDE_MAX_LANES];
+	uint8_t zResult[WIDE_MAX_LANES];
+	uint8_t carry[WIDE_MAX_LANES];
+	uint8_t overflow[WIDE_MAX_LANES];
+	uint16_t pc[WIDE_MAX_LANES];
+	// each lane's scheduler.cpuTime and scheduler.next, the lane gets caught up once its time is past next
+	uint64_t time[WIDE_MAX_LANES];
+	uint64_t next[WIDE_MAX_LANES];
+
+	nes_t* lanes[WIDE_MAX_LANES];
+	uint32_t laneCount;
+
+	// a bit for each lane
+	// lanes that haven't got to the end of the frame yet
+	uint32_t running;
+	// lanes that left the others this frame
+	uint32_t diverged;
+	// time is past next
+	uint32_t late;
+	uint32_t dmaActive;
+	// an interrupt gets taken after the next instruction, so it has to go through cpuStep()
+	uint32_t pending;
+	// cpu.irq is 0, cpuStep() sets it back to 1 after every instruction
+	uint32_t irqLow;
+	uint8_t waiting[WIDE_MAX_LANES];
+	uint8_t alone[WIDE_MAX_LANES];
+
+	// instructions run together (counted once for every lane) and one lane at a time, and frames finished by nesMain()
+	uint64_t together;
+	uint64_t solo;
+	uint64_t fallbacks;
+} wide_t;
+
+// what each opcode does as far as running it on every lane at once goes, and the fastest kernels this cpu has
+void wideInit(void);
+
+// the lanes are consoles with the same rom already loaded, nothing else can run them while they're in a wide_t
+// returns NULL if there are too many of them
+wide_t* wideCreate(nes_t** lanes, uint32_t count);
+void wideDestroy(wide_t* wide);
+// runs every lane until the start of its next vblank, it ends up the same as running each of them with nesMain() would
+void wideStepFrame(wide_t* wide);
+
+// runs lanes consoles for frames frames with the wide core and with the normal one on a thread for each,
+// checks they end up the same and prints how many frames a second each one gets out of a core
+uint8_t wideBenchmark(const char* path, uint32_t lanes, uint32_t frames);
+
+#endif
+
+#endif // WIDE_H